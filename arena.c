@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "a.h"
+
+/* every allocation is preceded by its size, so arena_realloc() knows how
+ * much to copy */
+#define HEADER_SZ (ARENA_ALIGN)
+
+static size_t align(size_t x)
+{
+	return (x + (ARENA_ALIGN-1)) & ~(size_t)(ARENA_ALIGN-1);
+}
+
+static struct arena_chunk* new_chunk(size_t size)
+{
+	struct arena_chunk* chunk = malloc(sizeof(*chunk));
+	AN(chunk);
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->data = malloc(size);
+	AN(chunk->data);
+	return chunk;
+}
+
+void arena_init(struct arena* arena, size_t chunk_size)
+{
+	memset(arena, 0, sizeof(*arena));
+	arena->chunk_size = align(chunk_size);
+	arena->first = arena->current = new_chunk(arena->chunk_size);
+}
+
+void arena_free(struct arena* arena)
+{
+	struct arena_chunk* chunk = arena->first;
+	while (chunk) {
+		struct arena_chunk* next = chunk->next;
+		free(chunk->data);
+		free(chunk);
+		chunk = next;
+	}
+	memset(arena, 0, sizeof(*arena));
+}
+
+void* arena_alloc(struct arena* arena, size_t sz)
+{
+	size_t need = HEADER_SZ + align(sz);
+
+	struct arena_chunk* chunk = arena->current;
+	if (chunk->used + need > chunk->size) {
+		/* move on to the next chunk, or put a big enough one in front
+		 * of it */
+		if (chunk->next == NULL || chunk->next->size < need) {
+			size_t size = arena->chunk_size;
+			while (size < need) size *= 2;
+			struct arena_chunk* fresh = new_chunk(size);
+			fresh->next = chunk->next;
+			chunk->next = fresh;
+		}
+		chunk = arena->current = chunk->next;
+		chunk->used = 0;
+	}
+
+	uint8_t* p = chunk->data + chunk->used;
+	chunk->used += need;
+	arena->used += need;
+	if (arena->used > arena->peak) arena->peak = arena->used;
+
+	*(size_t*)p = sz;
+	arena->last = p + HEADER_SZ;
+	return arena->last;
+}
+
+void* arena_realloc(struct arena* arena, void* ptr, size_t sz)
+{
+	if (ptr == NULL) return arena_alloc(arena, sz);
+
+	size_t old_sz = *(size_t*)((uint8_t*)ptr - HEADER_SZ);
+
+	// grow/shrink in place if it's the most recent allocation
+	struct arena_chunk* chunk = arena->current;
+	if (ptr == arena->last) {
+		size_t offset = (uint8_t*)ptr - chunk->data;
+		size_t end = offset + align(sz);
+		if (end <= chunk->size) {
+			size_t old_end = chunk->used;
+			chunk->used = end;
+			arena->used = arena->used - old_end + end;
+			if (arena->used > arena->peak) arena->peak = arena->used;
+			*(size_t*)((uint8_t*)ptr - HEADER_SZ) = sz;
+			return ptr;
+		}
+	}
+
+	void* p = arena_alloc(arena, sz);
+	memcpy(p, ptr, old_sz < sz ? old_sz : sz);
+	return p;
+}
+
+struct arena_mark arena_save(struct arena* arena)
+{
+	struct arena_mark mark;
+	mark.chunk = arena->current;
+	mark.used = arena->current->used;
+	mark.total_used = arena->used;
+	return mark;
+}
+
+void arena_rewind(struct arena* arena, struct arena_mark mark)
+{
+	arena->current = mark.chunk;
+	arena->current->used = mark.used;
+	arena->used = mark.total_used;
+	arena->last = NULL;
+}
+
+void arena_reset(struct arena* arena)
+{
+	arena->current = arena->first;
+	arena->current->used = 0;
+	arena->used = 0;
+	arena->last = NULL;
+}
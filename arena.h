@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* linear allocator. allocations are bumped out of a list of chunks and
+ * released all at once by rewinding to a mark; chunks are kept for reuse,
+ * so once an arena has seen its peak it stops touching the heap */
+
+#define ARENA_ALIGN (16)
+
+struct arena_chunk {
+	struct arena_chunk* next;
+	size_t size;
+	size_t used;
+	uint8_t* data;
+};
+
+struct arena {
+	size_t chunk_size;
+	struct arena_chunk* first;
+	struct arena_chunk* current;
+	void* last; // most recent allocation (may be grown in place)
+	size_t used; // bytes in use, over all chunks
+	size_t peak;
+};
+
+struct arena_mark {
+	struct arena_chunk* chunk;
+	size_t used;
+	size_t total_used;
+};
+
+void arena_init(struct arena* arena, size_t chunk_size);
+void arena_free(struct arena* arena);
+
+void* arena_alloc(struct arena* arena, size_t sz);
+void* arena_realloc(struct arena* arena, void* ptr, size_t sz);
+
+struct arena_mark arena_save(struct arena* arena);
+void arena_rewind(struct arena* arena, struct arena_mark mark);
+void arena_reset(struct arena* arena);
+
+#endif/*ARENA_H*/
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "demo.h"
+#include "tick.h"
+#include "a.h"
+
+struct demo_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tick_hz;
+	uint32_t seed;
+	uint32_t plan_len;
+};
+
+#define DEMO_TICK_SZ (5)
+
+void demo_record(struct demo* demo, const char* path, const char* plan, uint32_t seed)
+{
+	memset(demo, 0, sizeof(*demo));
+	size_t plan_len = strlen(plan);
+	if (plan_len >= DEMO_PLAN_MAX) arghf("%s: plan name too long for a demo", plan);
+	memcpy(demo->plan, plan, plan_len + 1);
+	demo->seed = seed;
+	demo->recording = 1;
+
+	demo->file = fopen(path, "wb");
+	if (demo->file == NULL) arghf("%s: could not open for writing", path);
+
+	struct demo_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = DEMO_MAGIC;
+	header.version = DEMO_VERSION;
+	header.tick_hz = TICK_HZ;
+	header.seed = seed;
+	header.plan_len = plan_len;
+	if (fwrite(&header, sizeof(header), 1, demo->file) != 1) arghf("%s: write failed", path);
+	if (fwrite(plan, plan_len, 1, demo->file) != 1) arghf("%s: write failed", path);
+}
+
+void demo_play(struct demo* demo, const char* path)
+{
+	memset(demo, 0, sizeof(*demo));
+
+	demo->file = fopen(path, "rb");
+	if (demo->file == NULL) arghf("%s: could not open demo", path);
+
+	struct demo_header header;
+	if (fread(&header, sizeof(header), 1, demo->file) != 1) arghf("%s: truncated demo", path);
+	if (header.magic != DEMO_MAGIC) arghf("%s: not a demo", path);
+	if (header.version != DEMO_VERSION) arghf("%s: demo version %u; expected %u", path, header.version, DEMO_VERSION);
+	if (header.tick_hz != TICK_HZ) arghf("%s: demo recorded at %uhz; the simulation runs at %dhz", path, header.tick_hz, TICK_HZ);
+	if (header.plan_len >= DEMO_PLAN_MAX) arghf("%s: damaged demo", path);
+	if (fread(demo->plan, header.plan_len, 1, demo->file) != 1) arghf("%s: truncated demo", path);
+	demo->plan[header.plan_len] = 0;
+	demo->seed = header.seed;
+}
+
+void demo_write(struct demo* demo, struct demo_tick* tick)
+{
+	ASSERT(demo->recording);
+	uint8_t b[DEMO_TICK_SZ];
+	b[0] = tick->buttons;
+	b[1] = (uint16_t)tick->mouse_dx & 0xff;
+	b[2] = (uint16_t)tick->mouse_dx >> 8;
+	b[3] = (uint16_t)tick->mouse_dy & 0xff;
+	b[4] = (uint16_t)tick->mouse_dy >> 8;
+	if (fwrite(b, sizeof(b), 1, demo->file) != 1) arghf("demo write failed");
+	demo->n_ticks++;
+}
+
+int demo_read(struct demo* demo, struct demo_tick* tick)
+{
+	ASSERT(!demo->recording);
+	uint8_t b[DEMO_TICK_SZ];
+	if (fread(b, sizeof(b), 1, demo->file) != 1) return 0;
+	tick->buttons = b[0];
+	tick->mouse_dx = (int16_t)(b[1] | (b[2] << 8));
+	tick->mouse_dy = (int16_t)(b[3] | (b[4] << 8));
+	demo->n_ticks++;
+	return 1;
+}
+
+void demo_close(struct demo* demo)
+{
+	if (demo->file == NULL) return;
+	if (fclose(demo->file) != 0 && demo->recording) arghf("demo write failed");
+	demo->file = NULL;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+void demo_report(uint64_t* frame_times, int n, uint64_t frequency)
+{
+	if (n == 0) {
+		printf("timedemo: no frames\n");
+		return;
+	}
+
+	uint64_t* sorted = malloc(n * sizeof(*sorted));
+	AN(sorted);
+	memcpy(sorted, frame_times, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), cmp_u64);
+
+	uint64_t total = 0;
+	for (int i = 0; i < n; i++) total += sorted[i];
+
+	double ms = 1000.0 / (double)frequency;
+	double average = (double)total / (double)n * ms;
+	// (the 99th percentile frame time)
+	double low = (double)sorted[(n - 1) - (n - 1) / 100] * ms;
+	double worst = (double)sorted[n - 1] * ms;
+	free(sorted);
+
+	printf("timedemo: %d frames in %.2fs\n", n, (double)total / (double)frequency);
+	printf("  average %8.3fms (%.1f fps)\n", average, 1000.0 / average);
+	printf("  1%% low  %8.3fms (%.1f fps)\n", low, 1000.0 / low);
+	printf("  worst   %8.3fms (%.1f fps)\n", worst, 1000.0 / worst);
+}
@@ -0,0 +1,49 @@
+#ifndef DEMO_H
+#define DEMO_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* demos are the per-tick input of a play session, plus the plan and seed it
+ * was played on. the simulation is a function of those alone (see
+ * tick.h), so playing a demo back reproduces the session exactly. the
+ * header is native endian; each tick is 5 bytes */
+
+#define DEMO_MAGIC (0x4f4d4544) // "DEMO"
+#define DEMO_VERSION (1)
+#define DEMO_PLAN_MAX (256)
+
+#define DEMO_TURN_LEFT (1<<0)
+#define DEMO_TURN_RIGHT (1<<1)
+#define DEMO_STRAFE_LEFT (1<<2)
+#define DEMO_STRAFE_RIGHT (1<<3)
+#define DEMO_FORWARD (1<<4)
+#define DEMO_BACKWARD (1<<5)
+#define DEMO_OVERHEAD (1<<6)
+
+struct demo_tick {
+	uint8_t buttons;
+	int16_t mouse_dx, mouse_dy;
+};
+
+struct demo {
+	FILE* file;
+	int recording;
+	char plan[DEMO_PLAN_MAX];
+	uint32_t seed;
+	uint32_t n_ticks; // written or read so far
+};
+
+// these arghf() on errors
+void demo_record(struct demo* demo, const char* path, const char* plan, uint32_t seed);
+void demo_play(struct demo* demo, const char* path);
+void demo_write(struct demo* demo, struct demo_tick* tick);
+void demo_close(struct demo* demo);
+
+// returns 0 at the end of the demo
+int demo_read(struct demo* demo, struct demo_tick* tick);
+
+// prints average, 1% low and worst of n frame times (in counter units)
+void demo_report(uint64_t* frame_times, int n, uint64_t frequency);
+
+#endif/*DEMO_H*/
@@ -1,4 +1,8 @@
-// (group,type,radius)
-ENTDEF(MONSTER, "nightmare", 32)
-ENTDEF(MONSTER, "nomnom", 32)
-ENTDEF(PICKUP, "shotgun", 16)
+// (group,type,radius,height,draw,art,flags,think)
+// height: of the eyes/sprite top above the floor
+// draw: NONE, SPRITE or MESH; art: names_sprites index, or mesh (0: nomnom)
+// flags: ENTITY_* from lvl.h; think: ticks between moves, at least 1
+ENTDEF(PLAYER, "player", 32, 48, NONE, 0, ENTITY_CLIPS, 1)
+ENTDEF(MONSTER, "nightmare", 32, 48, SPRITE, 0, ENTITY_CLIPS, 1)
+ENTDEF(MONSTER, "nomnom", 32, 48, MESH, 0, ENTITY_CLIPS, 1)
+ENTDEF(PICKUP, "shotgun", 16, 16, SPRITE, 0, 0, 30)
@@ -3,7 +3,7 @@
 int main(int argc, char** argv)
 {
 	printf("return {\n");
-	#define ENTDEF(group,type,radius) printf("\t{group = \"%s\", type = \"%s\", radius = %d},\n", #group, type, radius);
+	#define ENTDEF(group,type,radius,height,draw,art,flags,think) printf("\t{group = \"%s\", type = \"%s\", radius = %d, height = %d},\n", #group, type, radius, height);
 	#include "entities.inc.h"
 	#undef ENTDEF
 	printf("}\n");
@@ -8,15 +8,31 @@
 #include "font.h"
 #include "names.h"
 #include "runtime.h"
+#include "watch.h"
+#include "tick.h"
+#include "prof.h"
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-w] <brickname>\n", argv0);
+	fprintf(stderr, "  -w    hot reload assets in gfx/, dgfx/ and workbench/\n");
+	exit(EXIT_FAILURE);
+}
 
 int main(int argc, char** argv)
 {
-	if (argc != 2) {
-		fprintf(stderr, "usage: %s <brickname>\n", argv[0]);
-		return EXIT_FAILURE;
-	}
+	int watching = 0;
 
-	char* brickname = argv[1];
+	int argi = 1;
+	for (; argi < argc && argv[argi][0] == '-'; argi++) {
+		if (strcmp(argv[argi], "-w") == 0) {
+			watching = 1;
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (argi != argc-1) usage(argv[0]);
+	char* brickname = argv[argi];
 
 	SAZ(SDL_Init(SDL_INIT_VIDEO));
 	atexit(SDL_Quit);
@@ -45,21 +61,15 @@ int main(int argc, char** argv)
 	SDL_GetWindowSize(window, &width, &height);
 
 
-	// get refresh rate
-	SDL_DisplayMode mode;
-	SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode);
-	printf("refresh rate: %dhz\n", mode.refresh_rate);
-	float dt = 1.0f / (float)mode.refresh_rate;
-	/* ^^^ XXX use refresh rate for dt per default to get a smoother
-	 * experience? allow time() based alternative? */
-
-
 	struct font font;
 	font_init(&font);
 
 	struct render render;
 	render_init(&render, window);
 
+	struct watch watch;
+	if (watching) watch_init(&watch);
+
 	struct lvl lvl;
 	lvl_init(&lvl);
 
@@ -69,6 +79,7 @@ int main(int argc, char** argv)
 
 	struct lvl_entity player;
 	memset(&player, 0, sizeof(player));
+	player.type = names_find_entity_type("player");
 
 	int exiting = 0;
 	//int go = 0;
@@ -110,9 +121,23 @@ int main(int argc, char** argv)
 	} ed = ED_NONE;
 
 	struct lvl_trace_result trace_result;
+
+	struct tick tick;
+	tick_init(&tick);
 	struct vec3 clicked_position;
 
 	while (!exiting) {
+		PROF_ZONE("frame");
+
+		if (watching) {
+			struct watch_asset* asset;
+			while ((asset = watch_poll(&watch)) != NULL) {
+				render_reload(&render, asset);
+				font_reload(&font, asset);
+				watch_free_asset(asset);
+			}
+		}
+
 		SDL_Event e;
 		int do_select = 0;
 		float tool_dx = 0;
@@ -130,6 +155,11 @@ int main(int argc, char** argv)
 				if (e.key.keysym.sym == SDLK_TAB) {
 					overhead_mode = !overhead_mode;
 				}
+				if (e.key.keysym.sym == SDLK_F12) {
+					if (watching) watch_pause(&watch);
+					prof_dump("trace.json");
+					if (watching) watch_resume(&watch);
+				}
 				//if (e.key.keysym.sym == SDLK_SPACE) {
 					//go = !go;
 				//}
@@ -248,12 +278,47 @@ int main(int argc, char** argv)
 			}
 		}
 
-		if (ctrl_turn_left || ctrl_turn_right) {
-			float turn_speed = 200;
-			float sgn = 0;
-			if (ctrl_turn_left) sgn -= 1.0f;
-			if (ctrl_turn_right) sgn += 1.0f;
-			player.yaw += dt * turn_speed * sgn;
+		int steps = tick_frame(&tick);
+		for (int i = 0; i < steps; i++) {
+			float dt = TICK_DT;
+			lvl_entity_begin_tick(&player);
+
+			if (ctrl_turn_left || ctrl_turn_right) {
+				float turn_speed = 200;
+				float sgn = 0;
+				if (ctrl_turn_left) sgn -= 1.0f;
+				if (ctrl_turn_right) sgn += 1.0f;
+				player.yaw += dt * turn_speed * sgn;
+			}
+
+			struct vec2 forward;
+			vec2_angle(&forward, player.yaw);
+			struct vec2 right;
+			vec2_normal(&right, &forward);
+
+			if (ctrl_forward || ctrl_backward) {
+				float move_speed = 1;
+				float sgn = 0;
+				if (ctrl_forward) sgn -= 1.0f;
+				if (ctrl_backward) sgn += 1.0f;
+				struct vec2 accel;
+				vec2_copy(&accel, &forward);
+				vec2_scalei(&accel, move_speed * sgn);
+				lvl_entity_accelerate(&lvl, &player, &accel, dt);
+			}
+
+			if (ctrl_strafe_left || ctrl_strafe_right) {
+				float strafe_speed = 0.7;
+				float sgn = 0;
+				if (ctrl_strafe_left) sgn -= 1.0f;
+				if (ctrl_strafe_right) sgn += 1.0f;
+				struct vec2 accel;
+				vec2_copy(&accel, &right);
+				vec2_scalei(&accel, strafe_speed * sgn);
+				lvl_entity_accelerate(&lvl, &player, &accel, dt);
+			}
+
+			lvl_entity_clipmove(&lvl, &player, dt);
 		}
 
 		struct vec2 forward;
@@ -261,50 +326,38 @@ int main(int argc, char** argv)
 		struct vec2 right;
 		vec2_normal(&right, &forward);
 
-		if (ctrl_forward || ctrl_backward) {
-			float move_speed = 1;
-			float sgn = 0;
-			if (ctrl_forward) sgn -= 1.0f;
-			if (ctrl_backward) sgn += 1.0f;
-			struct vec2 accel;
-			vec2_copy(&accel, &forward);
-			vec2_scalei(&accel, move_speed * sgn);
-			lvl_entity_accelerate(&lvl, &player, &accel, dt);
-		}
-
-		if (ctrl_strafe_left || ctrl_strafe_right) {
-			float strafe_speed = 0.7;
-			float sgn = 0;
-			if (ctrl_strafe_left) sgn -= 1.0f;
-			if (ctrl_strafe_right) sgn += 1.0f;
-			struct vec2 accel;
-			vec2_copy(&accel, &right);
-			vec2_scalei(&accel, strafe_speed * sgn);
-			lvl_entity_accelerate(&lvl, &player, &accel, dt);
-		}
-
-		lvl_entity_clipmove(&lvl, &player, dt);
+		struct lvl_entity camera;
+		lvl_entity_lerp(&camera, &player, tick.alpha);
+		// (the lerped position needn't be in the player's sector)
+		lvl_entity_update_sector(&lvl, &camera);
+		if (camera.sector == -1) camera.sector = player.sector;
 
 
 		if (tool_dx != 0 || tool_dy != 0) {
+			// (tools only visit the tagged elements)
+			struct lvl_idset* sectors = &lvl.tags.sectors;
+			struct lvl_idset* sidedefs = &lvl.tags.sidedefs;
 			if (ed == ED_FLAT_Z) {
-				for (int i = 0; i < lvl.n_sectors; i++) {
-					struct lvl_sector* sector = lvl_get_sector(&lvl, i);
+				for (int i = 0; i < sectors->n; i++) {
+					if (!(sectors->flags[i] & LVL_SELECTED)) continue;
+					struct lvl_sector* sector = lvl_get_sector(&lvl, sectors->ids[i]);
 					float d = tool_dy * 8;
-					if (sector->usr & LVL_SELECTED_ZMINUS) {
+					if (sectors->flags[i] & LVL_SELECTED_ZMINUS) {
 						sector->flat[0].z += d;
 					}
-					if (sector->usr & LVL_SELECTED_ZPLUS) {
+					if (sectors->flags[i] & LVL_SELECTED_ZPLUS) {
 						sector->flat[1].z += d;
 					}
+					lvl_tag_sector_dirty(&lvl, sectors->ids[i]);
 				}
 			}
 			if (ed == ED_FLAT_TEXTURE || ed == ED_FLAT_TEXTURE_TRANSLATE) {
-				for (int i = 0; i < lvl.n_sectors; i++) {
-					struct lvl_sector* sector = lvl_get_sector(&lvl, i);
+				for (int i = 0; i < sectors->n; i++) {
+					if (!(sectors->flags[i] & LVL_SELECTED)) continue;
+					struct lvl_sector* sector = lvl_get_sector(&lvl, sectors->ids[i]);
 
 					for (int flati = 0; flati < 2; flati++) {
-						if (sector->usr & (flati == 0 ? LVL_SELECTED_ZMINUS : LVL_SELECTED_ZPLUS)) {
+						if (sectors->flags[i] & (flati == 0 ? LVL_SELECTED_ZMINUS : LVL_SELECTED_ZPLUS)) {
 							struct lvl_flat* flat = &sector->flat[flati];
 							if (ed == ED_FLAT_TEXTURE) {
 								flat->texture = clampi(flat->texture + (int)tool_dy, 0, names_number_of_flats()-1);
@@ -320,44 +373,38 @@ int main(int argc, char** argv)
 							}
 						}
 					}
+					lvl_tag_sector_dirty(&lvl, sectors->ids[i]);
 				}
 			}
 			if (ed == ED_SIDEDEF_TEXTURE || ed == ED_SIDEDEF_TEXTURE_TRANSLATE) {
-				for (int i = 0; i < lvl.n_sectors; i++) {
-					struct lvl_sector* sector = lvl_get_sector(&lvl, i);
-
-					for (int j = 0; j < sector->contourn; j++) {
-						int32_t ci = sector->contour0 + j;
-						struct lvl_contour* c = lvl_get_contour(&lvl, ci);
-						struct lvl_linedef* ld = lvl_get_linedef(&lvl, c->linedef);
-						uint32_t sdi = ld->sidedef[c->usr&1];
-						ASSERT(sdi != -1);
-						struct lvl_sidedef* sd = lvl_get_sidedef(&lvl, sdi);
-						for (int zdi = 0; zdi < 2; zdi++) {
-							if (sd->usr & (zdi == 0 ? LVL_SELECTED_ZMINUS : LVL_SELECTED_ZPLUS)) {
-								if (ed == ED_SIDEDEF_TEXTURE) {
-									sd->texture[zdi] = clampi(sd->texture[zdi] + (int)tool_dy, 0, names_number_of_walls()-1);
-								}
-								if (ed == ED_SIDEDEF_TEXTURE_TRANSLATE) {
-									// XXX flip if mirrored?
-									float scale = 2.5f;
-									sd->tx[zdi].s[4] -= tool_dx * scale;
-									sd->tx[zdi].s[5] -= tool_dy * scale;
-								}
+				for (int i = 0; i < sidedefs->n; i++) {
+					if (!(sidedefs->flags[i] & LVL_SELECTED)) continue;
+					struct lvl_sidedef* sd = lvl_get_sidedef(&lvl, sidedefs->ids[i]);
+					for (int zdi = 0; zdi < 2; zdi++) {
+						if (sidedefs->flags[i] & (zdi == 0 ? LVL_SELECTED_ZMINUS : LVL_SELECTED_ZPLUS)) {
+							if (ed == ED_SIDEDEF_TEXTURE) {
+								sd->texture[zdi] = clampi(sd->texture[zdi] + (int)tool_dy, 0, names_number_of_walls()-1);
+							}
+							if (ed == ED_SIDEDEF_TEXTURE_TRANSLATE) {
+								// XXX flip if mirrored?
+								float scale = 2.5f;
+								sd->tx[zdi].s[4] -= tool_dx * scale;
+								sd->tx[zdi].s[5] -= tool_dy * scale;
 							}
 						}
 					}
+					lvl_tag_sidedef_dirty(&lvl, sidedefs->ids[i]);
 				}
 			}
 			if (ed == ED_LIGHT_LEVEL) {
-				for (int i = 0; i < lvl.n_sectors; i++) {
-					struct lvl_sector* sector = lvl_get_sector(&lvl, i);
+				for (int i = 0; i < sectors->n; i++) {
+					if (!(sectors->flags[i] & LVL_SELECTED_ZMINUS)) continue;
+					struct lvl_sector* sector = lvl_get_sector(&lvl, sectors->ids[i]);
 					float d = tool_dy * 0.0125f;
-					if (sector->usr & LVL_SELECTED_ZMINUS) {
-						sector->light_level += d;
-						if (sector->light_level < 0) sector->light_level = 0;
-						if (sector->light_level > 1) sector->light_level = 1;
-					}
+					sector->light_level += d;
+					if (sector->light_level < 0) sector->light_level = 0;
+					if (sector->light_level > 1) sector->light_level = 1;
+					lvl_tag_sector_dirty(&lvl, sectors->ids[i]);
 				}
 			}
 		}
@@ -407,8 +454,8 @@ int main(int argc, char** argv)
 		} else {
 			struct vec3 pos;
 			struct vec3 mdir;
-			lvl_entity_mouse(&player, &pos, &mdir, render_get_fovy(&render), mouse_x, mouse_y, width, height);
-			lvl_trace(&lvl, player.sector, &pos, &mdir, &trace_result);
+			lvl_entity_mouse(&camera, &pos, &mdir, render_get_fovy(&render), mouse_x, mouse_y, width, height);
+			lvl_trace(&lvl, camera.sector, &pos, &mdir, &trace_result);
 
 			lvl_tag_clear_highlights(&lvl);
 
@@ -422,7 +469,8 @@ int main(int argc, char** argv)
 				lvl_tag_sectors(&lvl, &trace_result, do_select);
 			}
 
-			render_set_entity_cam(&render, &player);
+			render_set_entity_cam(&render, &camera);
+			render_set_alpha(&render, tick.alpha);
 			render_lvl(&render, &lvl);
 
 			render_begin2d(&render);
@@ -447,9 +495,14 @@ int main(int argc, char** argv)
 			render_lvl_tags(&render, &lvl);
 		}
 
-		SDL_GL_SwapWindow(window);
+		{
+			PROF_ZONE("swap");
+			SDL_GL_SwapWindow(window);
+		}
 	}
 
+	render_print_stats(&render);
+
 	SDL_DestroyWindow(window);
 	SDL_GL_DeleteContext(glctx);
 
@@ -0,0 +1,461 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+
+#include "flat.h"
+#include "a.h"
+#include "prof.h"
+#include "stats.h"
+
+static void* tess_alloc(void* usr, unsigned int sz)
+{
+	return arena_alloc(usr, sz);
+}
+
+static void* tess_realloc(void* usr, void* ptr, unsigned int sz)
+{
+	return arena_realloc(usr, ptr, sz);
+}
+
+static void tess_free(void* usr, void* ptr)
+{
+	// (released by rewinding the arena)
+}
+
+void flat_tess_init(struct flat_tess* ft)
+{
+	memset(ft, 0, sizeof(*ft));
+
+	arena_init(&ft->arena, 1<<16);
+
+	TESSalloc ta;
+	memset(&ta, 0, sizeof(ta));
+	ta.memalloc = tess_alloc;
+	ta.memrealloc = tess_realloc;
+	ta.memfree = tess_free;
+	ta.userData = &ft->arena;
+	ta.meshEdgeBucketSize = 64;
+	ta.meshVertexBucketSize = 64;
+	ta.meshFaceBucketSize = 32;
+	ta.dictNodeBucketSize = 64;
+	ta.regionBucketSize = 32;
+	ta.extraVertices = 0;
+
+	ft->tess = tessNewTess(&ta);
+	AN(ft->tess);
+
+	ft->mark = arena_save(&ft->arena);
+}
+
+void flat_tess_free(struct flat_tess* ft)
+{
+	// (the tesselator lives in the arena too)
+	arena_free(&ft->arena);
+	memset(ft, 0, sizeof(*ft));
+}
+
+static float cross(const struct vec2* a, const struct vec2* b, const struct vec2* c)
+{
+	return (b->s[0] - a->s[0]) * (c->s[1] - a->s[1]) - (b->s[1] - a->s[1]) * (c->s[0] - a->s[0]);
+}
+
+static int sgn(float x)
+{
+	return (x > 0) - (x < 0);
+}
+
+static int on_segment(const struct vec2* a, const struct vec2* b, const struct vec2* p)
+{
+	return
+		fminf(a->s[0], b->s[0]) <= p->s[0] && p->s[0] <= fmaxf(a->s[0], b->s[0]) &&
+		fminf(a->s[1], b->s[1]) <= p->s[1] && p->s[1] <= fmaxf(a->s[1], b->s[1]);
+}
+
+// (touching counts)
+static int segments_intersect(const struct vec2* a, const struct vec2* b, const struct vec2* c, const struct vec2* d)
+{
+	int d0 = sgn(cross(c, d, a));
+	int d1 = sgn(cross(c, d, b));
+	int d2 = sgn(cross(a, b, c));
+	int d3 = sgn(cross(a, b, d));
+	if (d0 * d1 < 0 && d2 * d3 < 0) return 1;
+	if (d0 == 0 && on_segment(c, d, a)) return 1;
+	if (d1 == 0 && on_segment(c, d, b)) return 1;
+	if (d2 == 0 && on_segment(a, b, c)) return 1;
+	if (d3 == 0 && on_segment(a, b, d)) return 1;
+	return 0;
+}
+
+/* classifies a single contour. returns FLAT_CONVEX if every turn is
+ * strictly convex, FLAT_SIMPLE if it's simple but not that, and
+ * FLAT_COMPLEX if it's self-intersecting, degenerate or too big to bother
+ * (libtess2's sweep wins there). *orientation is the winding sign */
+static enum flat_kind classify(const struct vec2* p, int n, int* orientation)
+{
+	if (n < 3 || n > FLAT_FAST_MAX_VERTICES) return FLAT_COMPLEX;
+
+	float area = 0;
+	for (int i = 0; i < n; i++) {
+		const struct vec2* a = &p[i];
+		const struct vec2* b = &p[(i+1)%n];
+		if (a->s[0] == b->s[0] && a->s[1] == b->s[1]) return FLAT_COMPLEX;
+		area += a->s[0] * b->s[1] - b->s[0] * a->s[1];
+	}
+	*orientation = sgn(area);
+	if (*orientation == 0) return FLAT_COMPLEX;
+
+	int convex = 1;
+	for (int i = 0; i < n; i++) {
+		const struct vec2* a = &p[i];
+		const struct vec2* b = &p[(i+1)%n];
+		const struct vec2* c = &p[(i+2)%n];
+		int turn = sgn(cross(a, b, c));
+		if (turn != *orientation) convex = 0;
+		// folding back onto the previous edge
+		if (turn == 0 && ((b->s[0]-a->s[0])*(c->s[0]-b->s[0]) + (b->s[1]-a->s[1])*(c->s[1]-b->s[1])) < 0) return FLAT_COMPLEX;
+	}
+
+	/* a strictly convex polygon can still wind around more than once, so
+	 * check for crossings either way */
+	for (int i = 0; i < n; i++) {
+		for (int j = i + 2; j < n; j++) {
+			if (i == 0 && j == n-1) continue; // (adjacent)
+			if (segments_intersect(&p[i], &p[(i+1)%n], &p[j], &p[(j+1)%n])) return FLAT_COMPLEX;
+		}
+	}
+
+	return convex ? FLAT_CONVEX : FLAT_SIMPLE;
+}
+
+// inside or on the boundary of triangle abc, wound as orientation
+static int in_triangle(const struct vec2* a, const struct vec2* b, const struct vec2* c, const struct vec2* p, int orientation)
+{
+	return
+		sgn(cross(a, b, p)) != -orientation &&
+		sgn(cross(b, c, p)) != -orientation &&
+		sgn(cross(c, a, p)) != -orientation;
+}
+
+/* ear clipping; triangles keep the contour's winding, like libtess2's.
+ * returns the number of triangles, or -1 if it got stuck on a degenerate
+ * configuration */
+static int ear_clip(struct flat_tess* ft, const struct vec2* p, int n, int orientation, int* indices)
+{
+	int* next = arena_alloc(&ft->arena, n * sizeof(int));
+	int* prev = arena_alloc(&ft->arena, n * sizeof(int));
+	for (int i = 0; i < n; i++) {
+		next[i] = (i+1)%n;
+		prev[i] = (i+n-1)%n;
+	}
+
+	int n_triangles = 0;
+	int remaining = n;
+	int i = 0;
+	int misses = 0;
+	while (remaining > 3) {
+		if (misses > remaining) return -1;
+
+		int a = prev[i];
+		int b = i;
+		int c = next[i];
+
+		int ear = sgn(cross(&p[a], &p[b], &p[c])) == orientation;
+		for (int j = next[c]; ear && j != a; j = next[j]) {
+			if (in_triangle(&p[a], &p[b], &p[c], &p[j], orientation)) ear = 0;
+		}
+
+		if (!ear) {
+			i = next[i];
+			misses++;
+			continue;
+		}
+
+		indices[n_triangles*3+0] = a;
+		indices[n_triangles*3+1] = b;
+		indices[n_triangles*3+2] = c;
+		n_triangles++;
+
+		next[a] = c;
+		prev[c] = a;
+		remaining--;
+		i = c;
+		misses = 0;
+	}
+
+	indices[n_triangles*3+0] = prev[i];
+	indices[n_triangles*3+1] = i;
+	indices[n_triangles*3+2] = next[i];
+	n_triangles++;
+
+	return n_triangles;
+}
+
+static int fast_path(struct flat_tess* ft, const struct vec2* p, int n, struct flat_mesh* mesh)
+{
+	int orientation;
+	enum flat_kind kind = classify(p, n, &orientation);
+	if (kind == FLAT_COMPLEX) return 0;
+
+	int* indices = arena_alloc(&ft->arena, (n-2) * 3 * sizeof(int));
+	int n_triangles;
+	if (kind == FLAT_CONVEX) {
+		n_triangles = n-2;
+		for (int i = 0; i < n_triangles; i++) {
+			indices[i*3+0] = 0;
+			indices[i*3+1] = i+1;
+			indices[i*3+2] = i+2;
+		}
+	} else {
+		n_triangles = ear_clip(ft, p, n, orientation, indices);
+		if (n_triangles == -1) return 0;
+	}
+
+	ft->n_by_kind[kind]++;
+
+	mesh->n_vertices = n;
+	mesh->vertices = (const float*)p;
+	mesh->n_triangles = n_triangles;
+	mesh->indices = indices;
+	return 1;
+}
+
+void flat_tess_sector(struct flat_tess* ft, struct lvl* lvl, int sectori, struct flat_mesh* mesh)
+{
+	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
+	ASSERT(sector->contourn > 0);
+
+	struct vec2* points = arena_alloc(&ft->arena, sector->contourn * sizeof(struct vec2));
+	int* contours = arena_alloc(&ft->arena, (sector->contourn + 1) * sizeof(int));
+	int n_contours = 0;
+
+	int32_t p = 0;
+	int32_t p0 = -1;
+
+	int begun = 0;
+	for (int i = 0; i < sector->contourn; i++) {
+		int ci = sector->contour0 + i;
+
+		if (p0 == -1) p0 = p;
+
+		struct lvl_contour* c = lvl_get_contour(lvl, ci);
+
+		struct lvl_linedef* l = lvl_get_linedef(lvl, c->linedef);
+		struct vec2* v = lvl_get_vertex(lvl, l->vertex[c->usr&1]);
+		AN(v);
+
+		if (LVL_CONTOUR_IS_FIRST(c)) {
+			p0 = p;
+			AZ(begun);
+			begun = 1;
+		}
+
+		memcpy(&points[p], v, sizeof(struct vec2));
+
+		if (LVL_CONTOUR_IS_LAST(c)) {
+			ASSERT(p > p0);
+			contours[n_contours++] = p0;
+			p0 = -1;
+			AN(begun);
+			begun = 0;
+		}
+
+		p++;
+	}
+	contours[n_contours] = p;
+
+	if (n_contours == 1 && !ft->sweep_only && fast_path(ft, points, p, mesh)) return;
+
+	for (int i = 0; i < n_contours; i++) {
+		tessAddContour(ft->tess, 2, &points[contours[i]], sizeof(struct vec2), contours[i+1] - contours[i]);
+	}
+
+	int tess_result = tessTesselate(ft->tess, TESS_WINDING_POSITIVE, TESS_POLYGONS, 3, 2, NULL);
+	ASSERT(tess_result == 1);
+
+	ft->n_by_kind[FLAT_COMPLEX]++;
+
+	mesh->n_vertices = tessGetVertexCount(ft->tess);
+	mesh->vertices = tessGetVertices(ft->tess);
+	mesh->n_triangles = tessGetElementCount(ft->tess);
+	mesh->indices = tessGetElements(ft->tess);
+}
+
+void flat_tess_end(struct flat_tess* ft)
+{
+	tessReset(ft->tess);
+	arena_rewind(&ft->arena, ft->mark);
+}
+
+struct flat_worker {
+	struct lvl* lvl;
+	int sector0, sector1;
+
+	struct flat_tess ft;
+
+	// per sector counts, then the worker's part of the cache
+	uint32_t* n_vertices;
+	uint32_t* n_indices;
+	uint32_t vertex_n, vertex_reserved;
+	float* vertices;
+	uint32_t index_n, index_reserved;
+	int* indices;
+};
+
+static void* grow(void* data, uint32_t* reserved, uint32_t n, size_t elem_sz)
+{
+	if (n <= *reserved) return data;
+	uint32_t r = *reserved ? *reserved : 1024;
+	while (r < n) r *= 2;
+	data = realloc(data, r * elem_sz);
+	AN(data);
+	*reserved = r;
+	return data;
+}
+
+static int flat_worker_run(void* usr)
+{
+	struct flat_worker* w = usr;
+
+	flat_tess_init(&w->ft);
+
+	for (int i = w->sector0; i < w->sector1; i++) {
+		struct flat_mesh mesh;
+		flat_tess_sector(&w->ft, w->lvl, i, &mesh);
+
+		int nv = mesh.n_vertices;
+		int ni = mesh.n_triangles * 3;
+		w->vertices = grow(w->vertices, &w->vertex_reserved, w->vertex_n + nv, 2 * sizeof(float));
+		w->indices = grow(w->indices, &w->index_reserved, w->index_n + ni, sizeof(int));
+		memcpy(&w->vertices[w->vertex_n * 2], mesh.vertices, nv * 2 * sizeof(float));
+		memcpy(&w->indices[w->index_n], mesh.indices, ni * sizeof(int));
+		w->vertex_n += nv;
+		w->index_n += ni;
+		w->n_vertices[i - w->sector0] = nv;
+		w->n_indices[i - w->sector0] = ni;
+
+		flat_tess_end(&w->ft);
+	}
+
+	flat_tess_free(&w->ft);
+
+	return 0;
+}
+
+static int flat_thread_run(void* usr)
+{
+	PROF_THREAD_BEGIN("flat");
+	{
+		PROF_ZONE("flat_worker");
+		flat_worker_run(usr);
+	}
+	PROF_THREAD_END();
+	return 0;
+}
+
+void flat_cache_init(struct flat_cache* fc)
+{
+	memset(fc, 0, sizeof(*fc));
+}
+
+void flat_cache_free(struct flat_cache* fc)
+{
+	free(fc->vertex0);
+	free(fc->index0);
+	free(fc->vertices);
+	free(fc->indices);
+	memset(fc, 0, sizeof(*fc));
+}
+
+static int n_workers_for(int n_sectors)
+{
+	int n = SDL_GetCPUCount();
+	if (n > FLAT_MAX_THREADS) n = FLAT_MAX_THREADS;
+	int max = n_sectors / FLAT_MIN_SECTORS_PER_THREAD;
+	if (n > max) n = max;
+	if (n < 1) n = 1;
+	return n;
+}
+
+static void flat_cache_build(struct flat_cache* fc, struct lvl* lvl)
+{
+	PROF_ZONE("flat_cache_build");
+
+	flat_cache_free(fc);
+
+	int n_sectors = lvl->n_sectors;
+	int n_workers = n_workers_for(n_sectors);
+
+	struct flat_worker workers[FLAT_MAX_THREADS];
+	SDL_Thread* threads[FLAT_MAX_THREADS];
+
+	fc->vertex0 = malloc((n_sectors + 1) * sizeof(uint32_t));
+	AN(fc->vertex0);
+	fc->index0 = malloc((n_sectors + 1) * sizeof(uint32_t));
+	AN(fc->index0);
+
+	for (int i = 0; i < n_workers; i++) {
+		struct flat_worker* w = &workers[i];
+		memset(w, 0, sizeof(*w));
+		w->lvl = lvl;
+		w->sector0 = (int64_t)n_sectors * i / n_workers;
+		w->sector1 = (int64_t)n_sectors * (i+1) / n_workers;
+		/* per sector counts go straight into the prefix sum arrays,
+		 * which are summed in place below */
+		w->n_vertices = &fc->vertex0[w->sector0 + 1];
+		w->n_indices = &fc->index0[w->sector0 + 1];
+	}
+
+	// (the calling thread takes the first range)
+	for (int i = 1; i < n_workers; i++) {
+		threads[i] = SDL_CreateThread(flat_thread_run, "flat", &workers[i]);
+		SAN(threads[i]);
+	}
+	flat_worker_run(&workers[0]);
+	for (int i = 1; i < n_workers; i++) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	fc->vertex0[0] = 0;
+	fc->index0[0] = 0;
+	for (int i = 0; i < n_sectors; i++) {
+		fc->vertex0[i+1] += fc->vertex0[i];
+		fc->index0[i+1] += fc->index0[i];
+	}
+
+	fc->vertices = malloc(fc->vertex0[n_sectors] * 2 * sizeof(float) + 1);
+	AN(fc->vertices);
+	fc->indices = malloc(fc->index0[n_sectors] * sizeof(int) + 1);
+	AN(fc->indices);
+	for (int i = 0; i < n_workers; i++) {
+		struct flat_worker* w = &workers[i];
+		memcpy(&fc->vertices[fc->vertex0[w->sector0] * 2], w->vertices, w->vertex_n * 2 * sizeof(float));
+		memcpy(&fc->indices[fc->index0[w->sector0]], w->indices, w->index_n * sizeof(int));
+		free(w->vertices);
+		free(w->indices);
+	}
+
+	fc->generation = lvl->generation;
+	fc->n_sectors = n_sectors;
+	fc->valid = 1;
+
+	STATS_ADD(tessellations, n_sectors);
+}
+
+void flat_cache_update(struct flat_cache* fc, struct lvl* lvl)
+{
+	if (fc->valid && fc->generation == lvl->generation && fc->n_sectors == lvl->n_sectors) return;
+	flat_cache_build(fc, lvl);
+}
+
+void flat_cache_get(struct flat_cache* fc, int sectori, struct flat_mesh* mesh)
+{
+	ASSERT(fc->valid);
+	ASSERT(sectori >= 0 && sectori < fc->n_sectors);
+	uint32_t v0 = fc->vertex0[sectori];
+	uint32_t i0 = fc->index0[sectori];
+	mesh->n_vertices = fc->vertex0[sectori+1] - v0;
+	mesh->vertices = &fc->vertices[v0 * 2];
+	mesh->n_triangles = (fc->index0[sectori+1] - i0) / 3;
+	mesh->indices = &fc->indices[i0];
+}
@@ -0,0 +1,85 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include <stdint.h>
+#include <tesselator.h>
+
+#include "arena.h"
+#include "lvl.h"
+
+/* sector flat tessellation (no GL here). one flat_tess is reused for every
+ * sector: libtess2 allocates out of its arena, and flat_tess_end() resets
+ * the tesselator and rewinds the arena to where tessNewTess() left it, so
+ * after the first few sectors tessellation does no heap traffic.
+ *
+ * most sectors are a single simple contour; those are fanned (convex) or
+ * ear clipped directly. only sectors with holes or several contours,
+ * self-intersections or lots of vertices go through libtess2's sweep */
+
+#define FLAT_FAST_MAX_VERTICES (64)
+
+enum flat_kind {
+	FLAT_CONVEX = 0,
+	FLAT_SIMPLE,
+	FLAT_COMPLEX,
+	FLAT_KIND_N
+};
+
+struct flat_tess {
+	struct arena arena;
+	struct arena_mark mark;
+	TESStesselator* tess;
+
+	int sweep_only; // skip the fast paths (to compare against libtess2)
+
+	// sectors tessellated, by path taken
+	int n_by_kind[FLAT_KIND_N];
+};
+
+// triangles over the sector's contours, wound for floors
+struct flat_mesh {
+	int n_vertices;
+	const float* vertices; // xy pairs
+	int n_triangles;
+	const int* indices; // 3 per triangle
+};
+
+void flat_tess_init(struct flat_tess* ft);
+void flat_tess_free(struct flat_tess* ft);
+
+// the mesh is valid until flat_tess_end()
+void flat_tess_sector(struct flat_tess* ft, struct lvl* lvl, int sectori, struct flat_mesh* mesh);
+void flat_tess_end(struct flat_tess* ft);
+
+/* tessellations of every sector of a level. flats only depend on the
+ * contours, so the cache stays valid through z, texture and light edits.
+ * it's built by splitting the sectors into contiguous ranges, one per
+ * worker thread (each with its own flat_tess), and stitching the results
+ * together in sector order, so the output doesn't depend on the number of
+ * threads */
+
+#define FLAT_MAX_THREADS (16)
+#define FLAT_MIN_SECTORS_PER_THREAD (256)
+
+struct flat_cache {
+	int valid;
+	uint32_t generation; // of the level it's for
+	uint32_t n_sectors;
+
+	uint32_t* vertex0; // n_sectors+1 prefix sums, in vertices
+	uint32_t* index0; // n_sectors+1 prefix sums, in indices
+	float* vertices; // xy pairs
+	int* indices; // relative to the sector's vertex0
+};
+
+void flat_cache_init(struct flat_cache* fc);
+void flat_cache_free(struct flat_cache* fc);
+
+/* (re)builds the cache unless it's valid for lvl. it's only checked by
+ * lvl's generation and sector count; nothing moves vertices or changes
+ * contours in place, and code that does has to flat_cache_free() the cache */
+void flat_cache_update(struct flat_cache* fc, struct lvl* lvl);
+
+void flat_cache_get(struct flat_cache* fc, int sectori, struct flat_mesh* mesh);
+
+#endif/*FLAT_H*/
@@ -5,11 +5,11 @@
 #include "a.h"
 #include "font.h"
 #include "mud.h"
+#include "stats.h"
+#include "frame.h"
 
 #define FLOATS_PER_VERTEX (8)
 
-#define RENDER_BUFSZ (16384)
-
 static const char* font_shader_vertex_src =
 	"#version 130\n"
 	"\n"
@@ -42,23 +42,29 @@ static const char* font_shader_fragment_src =
 	"	gl_FragColor = v_col;\n"
 	"}\n";
 
-static void font_init_font6_texture(struct font* font)
+static void font_upload_font6_texture(struct font* font, uint8_t* data, int width, int height)
 {
-	uint8_t* data;
-	int width = 0;
-	int height = 0;
-	AZ(mud_load_png_paletted("gfx/font6.png", &data, &width, &height));
 	ASSERT(width == 96);
 	ASSERT(height == 96);
 
 	int level = 0;
 	int border = 0;
 
-	glGenTextures(1, &font->font6_texture); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, font->font6_texture); CHKGL;
 	glTexImage2D(GL_TEXTURE_2D, level, 1, width, height, border, GL_RED, GL_UNSIGNED_BYTE, data); CHKGL;
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); CHKGL;
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
+}
+
+static void font_init_font6_texture(struct font* font)
+{
+	uint8_t* data;
+	int width = 0;
+	int height = 0;
+	AZ(mud_load_png_paletted("gfx/font6.png", &data, &width, &height));
+
+	glGenTextures(1, &font->font6_texture); CHKGL;
+	font_upload_font6_texture(font, data, width, height);
 
 	free(data);
 }
@@ -76,29 +82,37 @@ static void font_init_shader(struct font* font)
 
 static void font_init_buffers(struct font* font)
 {
-	glGenBuffers(1, &font->vertex_buffer); CHKGL;
-	glBindBuffer(GL_ARRAY_BUFFER, font->vertex_buffer); CHKGL;
-	size_t vertex_data_sz = RENDER_BUFSZ * sizeof(float) * FLOATS_PER_VERTEX;
-	font->vertex_data = malloc(vertex_data_sz);
-	AN(font->vertex_data);
-	glBufferData(GL_ARRAY_BUFFER, vertex_data_sz, font->vertex_data, GL_STREAM_DRAW); CHKGL;
+	stream_init(&font->vertices, GL_ARRAY_BUFFER, sizeof(float) * FLOATS_PER_VERTEX, 1024);
 
 	glGenBuffers(1, &font->index_buffer); CHKGL;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, font->index_buffer); CHKGL;
-	size_t index_data_sz = RENDER_BUFSZ * sizeof(uint32_t);
-	font->index_data = malloc(index_data_sz);
-	AN(font->index_data);
+	font->index_quads = 0;
+}
+
+// every glyph is a quad, so the index buffer is static; it only grows
+static void font_reserve_quads(struct font* font, int n)
+{
+	if (n <= font->index_quads) return;
+	int quads = font->index_quads ? font->index_quads : 256;
+	while (quads < n) quads *= 2;
+
+	size_t index_data_sz = quads * 6 * sizeof(uint32_t);
+	uint32_t* index_data = malloc(index_data_sz);
+	AN(index_data);
 	int offset = 0;
-	for (int i = 0; i < (RENDER_BUFSZ-6); i += 6) {
-		font->index_data[i+0] = 0 + offset;
-		font->index_data[i+1] = 1 + offset;
-		font->index_data[i+2] = 2 + offset;
-		font->index_data[i+3] = 0 + offset;
-		font->index_data[i+4] = 2 + offset;
-		font->index_data[i+5] = 3 + offset;
+	for (int i = 0; i < quads*6; i += 6) {
+		index_data[i+0] = 0 + offset;
+		index_data[i+1] = 1 + offset;
+		index_data[i+2] = 2 + offset;
+		index_data[i+3] = 0 + offset;
+		index_data[i+4] = 2 + offset;
+		index_data[i+5] = 3 + offset;
 		offset += 4;
 	}
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data_sz, font->index_data, GL_STATIC_DRAW); CHKGL;
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, font->index_buffer); CHKGL;
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data_sz, index_data, GL_STATIC_DRAW); CHKGL;
+	free(index_data);
+
+	font->index_quads = quads;
 }
 
 void font_init(struct font* font)
@@ -108,11 +122,21 @@ void font_init(struct font* font)
 	font_init_buffers(font);
 }
 
+void font_reload(struct font* font, struct watch_asset* asset)
+{
+	if (asset->kind != WATCH_FONT) return;
+	if (asset->width != 96 || asset->height != 96) {
+		fprintf(stderr, "font6 is %dx%d; expected 96x96; ignoring\n", asset->width, asset->height);
+		return;
+	}
+	font_upload_font6_texture(font, asset->data, asset->width, asset->height);
+}
+
 void font_begin(struct font* font, int face)
 {
 	ASSERT(face == 6);
 	font->face = face;
-	font->vertex_n = 0;
+	stream_reset(&font->vertices);
 }
 
 void font_end(struct font* font)
@@ -128,9 +152,12 @@ void font_end(struct font* font)
 	glActiveTexture(GL_TEXTURE0); CHKGL;
 	glEnable(GL_TEXTURE_2D); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, font->font6_texture); CHKGL;
+	STATS_ADD(texture_binds, 1);
+
+	int quads = font->vertices.n / 4;
+	font_reserve_quads(font, quads);
 
-	glBindBuffer(GL_ARRAY_BUFFER, font->vertex_buffer); CHKGL;
-	glBufferSubData(GL_ARRAY_BUFFER, 0, font->vertex_n * sizeof(float) * FLOATS_PER_VERTEX, font->vertex_data); CHKGL;
+	stream_upload(&font->vertices);
 
 	glEnableVertexAttribArray(font->a_pos); CHKGL;
 	glVertexAttribPointer(font->a_pos, 2, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_VERTEX, 0); CHKGL;
@@ -142,7 +169,8 @@ void font_end(struct font* font)
 	glVertexAttribPointer(font->a_col, 4, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_VERTEX, (char*)(sizeof(float)*4)); CHKGL;
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, font->index_buffer); CHKGL;
-	glDrawElements(GL_TRIANGLES, font->vertex_n/4*6, GL_UNSIGNED_INT, NULL); CHKGL;
+	glDrawElements(GL_TRIANGLES, quads*6, GL_UNSIGNED_INT, NULL); CHKGL;
+	STATS_ADD(draw_calls, 1);
 
 	glDisableVertexAttribArray(font->a_col); CHKGL;
 	glDisableVertexAttribArray(font->a_uv); CHKGL;
@@ -184,10 +212,10 @@ static int font_glyph_height(struct font* font)
 
 void font_printf(struct font* font, const char* fmt, ...)
 {
-	char buffer[16384];
 	va_list args;
 	va_start(args, fmt);
-	int len = vsprintf(buffer, fmt, args);
+	int len;
+	char* buffer = frame_vprintf(&len, fmt, args);
 	va_end(args);
 
 	for (int i = 0; i < len; i++) {
@@ -210,9 +238,7 @@ void font_printf(struct font* font, const char* fmt, ...)
 			float v = (float)y0 / 16.0;
 			float w = 1.0 / 16.0;
 
-			ASSERT((font->vertex_n+4) <= RENDER_BUFSZ);
-
-			float* f = &font->vertex_data[font->vertex_n * FLOATS_PER_VERTEX];
+			float* f = stream_push(&font->vertices, 4);
 
 			int i = 0;
 
@@ -244,7 +270,6 @@ void font_printf(struct font* font, const char* fmt, ...)
 			f[i++] = font->color1; f[i++] = 0; f[i++] = 0; f[i++] = 1;
 
 			font->cursor_dx += font_glyph_width(font);
-			font->vertex_n += 4;
 		}
 	}
 }
@@ -3,6 +3,8 @@
 
 #include <GL/glew.h>
 #include "shader.h"
+#include "watch.h"
+#include "stream.h"
 
 struct font {
 	GLuint font6_texture;
@@ -12,12 +14,10 @@ struct font {
 	GLuint a_uv;
 	GLuint a_col;
 
-	GLuint vertex_buffer;
-	float* vertex_data;
-	int vertex_n;
+	struct stream vertices;
 
 	GLuint index_buffer;
-	int32_t* index_data;
+	int index_quads;
 
 	int face;
 	float color0, color1;
@@ -27,6 +27,7 @@ struct font {
 };
 
 void font_init(struct font* font);
+void font_reload(struct font* font, struct watch_asset* asset);
 void font_begin(struct font* font, int face);
 void font_end(struct font* font);
 
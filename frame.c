@@ -0,0 +1,73 @@
+#include <stdio.h>
+
+#include "frame.h"
+#include "arena.h"
+#include "stats.h"
+#include "a.h"
+
+// (each thread has its own pair)
+static __thread struct arena arenas[2];
+static __thread int current = -1;
+static size_t peak; // over all threads
+
+static struct arena* get(void)
+{
+	if (current == -1) {
+		arena_init(&arenas[0], FRAME_CHUNK_SIZE);
+		arena_init(&arenas[1], FRAME_CHUNK_SIZE);
+		current = 0;
+	}
+	return &arenas[current];
+}
+
+void* frame_alloc(size_t sz)
+{
+	return arena_alloc(get(), sz);
+}
+
+char* frame_vprintf(int* len, const char* fmt, va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+	int n = vsnprintf(NULL, 0, fmt, copy);
+	va_end(copy);
+	ASSERT(n >= 0);
+
+	char* str = frame_alloc(n + 1);
+	vsnprintf(str, n + 1, fmt, args);
+
+	if (len != NULL) *len = n;
+	return str;
+}
+
+char* frame_printf(int* len, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	char* str = frame_vprintf(len, fmt, args);
+	va_end(args);
+	return str;
+}
+
+size_t frame_used(void)
+{
+	return current == -1 ? 0 : arenas[current].used;
+}
+
+size_t frame_peak(void)
+{
+	return peak;
+}
+
+void frame_flip(void)
+{
+	size_t used = frame_used();
+	for (size_t p = peak; used > p; p = peak) {
+		if (__sync_bool_compare_and_swap(&peak, p, used)) break;
+	}
+	STATS_ADD(frame_bytes, used);
+
+	get();
+	current ^= 1;
+	arena_reset(&arenas[current]);
+}
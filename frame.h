@@ -0,0 +1,27 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+/* per frame scratch memory, for things that used to go on the stack or
+ * through malloc() every frame. two arenas take turns: frame_flip() (done
+ * by render_flip()) switches to the other one and rewinds it, so an
+ * allocation stays good until the end of the frame after the one it was
+ * made in. nothing is freed individually. every thread gets arenas of its
+ * own, and flips them itself */
+
+#define FRAME_CHUNK_SIZE (1<<16)
+
+void* frame_alloc(size_t sz);
+// formatted into frame memory; *len (if not NULL) gets strlen()
+char* frame_printf(int* len, const char* fmt, ...) __attribute__((format (printf, 2, 3)));
+char* frame_vprintf(int* len, const char* fmt, va_list args);
+void frame_flip(void);
+
+/* bytes used by the calling thread's frame in progress, and the most any
+ * frame (on any thread) has used */
+size_t frame_used(void);
+size_t frame_peak(void);
+
+#endif/*FRAME_H*/
@@ -1,3 +1,4 @@
+#include <stdarg.h>
 #include <SDL.h>
 #include <GL/glew.h>
 
@@ -5,17 +6,373 @@
 #include "font.h"
 #include "render.h"
 #include "runtime.h"
+#include "watch.h"
 #include "lvl.h"
-#include "llvl.h"
+#include "names.h"
 #include "magic.h"
+#include "tick.h"
+#include "demo.h"
+#include "prof.h"
+#include "stats.h"
+#include "hud.h"
+#include "frame.h"
+#include "rthread.h"
+#include "loader.h"
+#include "world.h"
+
+struct input {
+	int turn_left;
+	int turn_right;
+	int strafe_left;
+	int strafe_right;
+	int forward;
+	int backward;
+	float mouse_dx, mouse_dy; // since the last tick
+	int overhead_mode;
+};
+
+// n counts the ticks since the level was loaded
+static void game_tick(struct lvl* lvl, struct lvl_entity* player, struct input* input, uint64_t n)
+{
+	PROF_ZONE("game_tick");
+
+	float dt = TICK_DT;
+
+	lvl_entity_begin_tick(player);
+	lvl_begin_tick(lvl);
+
+	float sensitivity = 0.3f;
+	player->yaw += input->mouse_dx * sensitivity;
+	if (!input->overhead_mode) {
+		player->pitch += input->mouse_dy * sensitivity;
+		float pitch_limit = 88;
+		if (player->pitch > pitch_limit) player->pitch = pitch_limit;
+		if (player->pitch < -pitch_limit) player->pitch = -pitch_limit;
+	}
+
+	if (input->turn_left || input->turn_right) {
+		float turn_speed = 200;
+		float sgn = 0;
+		if (input->turn_left) sgn -= 1.0f;
+		if (input->turn_right) sgn += 1.0f;
+		player->yaw += dt * turn_speed * sgn;
+	}
+
+	struct vec2 forward;
+	vec2_angle(&forward, player->yaw);
+	struct vec2 right;
+	vec2_normal(&right, &forward);
+
+	if (input->forward || input->backward) {
+		float move_force = 1;
+		float sgn = 0;
+		if (input->forward) sgn -= 1.0f;
+		if (input->backward) sgn += 1.0f;
+		struct vec2 accel;
+		vec2_copy(&accel, &forward);
+		vec2_scalei(&accel, move_force * sgn);
+		lvl_entity_accelerate(lvl, player, &accel, dt);
+	}
+
+	if (input->strafe_left || input->strafe_right) {
+		float strafe_force = 0.7;
+		float sgn = 0;
+		if (input->strafe_left) sgn -= 1.0f;
+		if (input->strafe_right) sgn += 1.0f;
+		struct vec2 accel;
+		vec2_copy(&accel, &right);
+		vec2_scalei(&accel, strafe_force * sgn);
+		lvl_entity_accelerate(lvl, player, &accel, dt);
+	}
+
+	lvl_entity_clipmove(lvl, player, dt);
+
+	/* XXX hack to set Z. entities move every think ticks (staggered, so
+	 * the slow ones don't all land on the same tick), and all of them on
+	 * the first, to put them on the floor */
+	for (int i = 0; i < lvl->n_entities; i++) {
+		struct lvl_entity* e = lvl_get_entity(lvl, i);
+		if (e->type == ENTITY_DELETED) continue;
+		int think = lvl_entity_type(e)->think;
+		if (n > 0 && (n + i) % think != 0) continue;
+		lvl_entity_clipmove(lvl, e, dt * (float)think);
+	}
+}
+
+static int16_t clamp16(float x)
+{
+	if (x > INT16_MAX) return INT16_MAX;
+	if (x < INT16_MIN) return INT16_MIN;
+	return (int16_t)x;
+}
+
+static void pack_input(struct demo_tick* dtick, struct input* input)
+{
+	dtick->buttons =
+		(input->turn_left ? DEMO_TURN_LEFT : 0) |
+		(input->turn_right ? DEMO_TURN_RIGHT : 0) |
+		(input->strafe_left ? DEMO_STRAFE_LEFT : 0) |
+		(input->strafe_right ? DEMO_STRAFE_RIGHT : 0) |
+		(input->forward ? DEMO_FORWARD : 0) |
+		(input->backward ? DEMO_BACKWARD : 0) |
+		(input->overhead_mode ? DEMO_OVERHEAD : 0);
+	dtick->mouse_dx = clamp16(input->mouse_dx);
+	dtick->mouse_dy = clamp16(input->mouse_dy);
+}
+
+static void unpack_input(struct input* input, struct demo_tick* dtick)
+{
+	input->turn_left = (dtick->buttons & DEMO_TURN_LEFT) != 0;
+	input->turn_right = (dtick->buttons & DEMO_TURN_RIGHT) != 0;
+	input->strafe_left = (dtick->buttons & DEMO_STRAFE_LEFT) != 0;
+	input->strafe_right = (dtick->buttons & DEMO_STRAFE_RIGHT) != 0;
+	input->forward = (dtick->buttons & DEMO_FORWARD) != 0;
+	input->backward = (dtick->buttons & DEMO_BACKWARD) != 0;
+	input->overhead_mode = (dtick->buttons & DEMO_OVERHEAD) != 0;
+	input->mouse_dx = dtick->mouse_dx;
+	input->mouse_dy = dtick->mouse_dy;
+}
+
+/* everything a frame is drawn from. the main thread records it into frame
+ * memory, and it's drawn right away, or on the render thread while the
+ * next frame is simulated. the game never changes the level's geometry,
+ * so that's read in place; the entities are copied. levels are swapped
+ * whole, and the old one is only freed once no packet can refer to it */
+struct text {
+	int x, y, color;
+	char* str;
+	struct text* next;
+};
+
+struct packet {
+	struct lvl* lvl; // NULL while the first level loads
+	struct flat_cache flats; // to adopt first, if valid
+	struct lvl* unload; // to free once this packet is drawn
+
+	int overhead_mode;
+	struct lvl_entity camera;
+	struct lvl_entity* entities; // interpolated
+	int n_entities;
+
+	struct text* texts;
+	struct text** texts_tail;
+	int show_hud;
+	struct stats stats; // (a copy, for the hud)
+
+	struct watch_asset* assets; // hot reloads to apply
+
+	struct stats_frame counters; // counted while drawing
+};
+
+struct gfx {
+	SDL_Window* window;
+	struct render render;
+	struct font font;
+};
+
+static void packet_text(struct packet* p, int x, int y, int color, const char* fmt, ...) __attribute__((format (printf, 5, 6)));
+static void packet_text(struct packet* p, int x, int y, int color, const char* fmt, ...)
+{
+	struct text* t = frame_alloc(sizeof(*t));
+	t->x = x;
+	t->y = y;
+	t->color = color;
+	va_list args;
+	va_start(args, fmt);
+	t->str = frame_vprintf(NULL, fmt, args);
+	va_end(args);
+	t->next = NULL;
+	*p->texts_tail = t;
+	p->texts_tail = &t->next;
+}
+
+static void draw_overhead(struct lvl* lvl, struct lvl_entity* camera)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+	glClearColor(0,0,0,0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); CHKGL;
+	glUseProgram(0);
+	glActiveTexture(GL_TEXTURE0); CHKGL;
+	glDisable(GL_TEXTURE_2D); CHKGL;
+	float overhead_scale = 0.125f;
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(-MAGIC_RWIDTH/2, MAGIC_RWIDTH/2, MAGIC_RHEIGHT/2, -MAGIC_RHEIGHT/2, 1, 0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	//glTranslatef(0,0,-400);
+	glScalef(overhead_scale, overhead_scale, overhead_scale);
+
+	glColor4f(1,0,0,1);
+	glBegin(GL_LINE_LOOP);
+	for (int i = 0; i < 32; i++) {
+		float r = lvl_entity_radius(camera);
+		float phi = (float)i / 32.0f * 6.2830f;
+		float x = cosf(phi) * r;
+		float y = sinf(phi) * r;
+		glVertex2f(x, y);
+	}
+	glEnd();
+
+	glRotatef(-camera->yaw, 0, 0, 1);
+	glTranslatef(-camera->position.s[0],-camera->position.s[1],0);
+
+	glBegin(GL_LINES);
+	for (int i = 0; i < lvl->n_linedefs; i++) {
+		struct lvl_linedef* l = lvl_get_linedef(lvl, i);
+		if (l->sidedef[0] == -1 || l->sidedef[1] == -1) {
+			glColor4f(1,1,1,1);
+		} else {
+			glColor4f(0,0.6,0.6,1);
+		}
+		struct vec2* v0 = lvl_get_vertex(lvl, l->vertex[0]);
+		glVertex2f(v0->s[0], v0->s[1]);
+		struct vec2* v1 = lvl_get_vertex(lvl, l->vertex[1]);
+		glVertex2f(v1->s[0], v1->s[1]);
+	}
+	glEnd();
+}
+
+// draws and swaps a packet; on the render thread if there is one
+static void draw_packet(void* usr, void* packet)
+{
+	struct gfx* gfx = usr;
+	struct packet* p = packet;
+
+	stats_reset_frame(&p->counters);
+	struct stats_frame* counters = stats_counters;
+	stats_counters = &p->counters;
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	for (struct watch_asset* asset = p->assets; asset != NULL; asset = asset->next) {
+		render_reload(&gfx->render, asset);
+		font_reload(&gfx->font, asset);
+	}
+
+	if (p->flats.valid) render_adopt_flats(&gfx->render, &p->flats);
+
+	if (p->lvl != NULL && p->overhead_mode) {
+		draw_overhead(p->lvl, &p->camera);
+		frame_flip(); // (render_flip() does it otherwise)
+	} else {
+		if (p->lvl != NULL) {
+			render_set_entity_cam(&gfx->render, &p->camera);
+			render_lvl_with_entities(&gfx->render, p->lvl, p->entities, p->n_entities);
+			render_begin2d(&gfx->render);
+		} else {
+			render_begin2d(&gfx->render);
+			glClearColor(0,0,0,0);
+			glClear(GL_COLOR_BUFFER_BIT); CHKGL;
+		}
+
+		font_begin(&gfx->font, 6);
+		for (struct text* t = p->texts; t != NULL; t = t->next) {
+			font_goto(&gfx->font, t->x, t->y);
+			font_color(&gfx->font, t->color);
+			font_printf(&gfx->font, "%s", t->str);
+		}
+		font_end(&gfx->font);
+		if (p->show_hud) hud_draw(&gfx->font, &p->stats);
+		render_flip(&gfx->render);
+	}
+
+	p->counters.render_ms = (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+	{
+		PROF_ZONE("swap");
+		SDL_GL_SwapWindow(gfx->window);
+	}
+
+	stats_counters = counters;
+}
+
+// once a packet is drawn
+static void retire_packet(struct packet* p)
+{
+	stats_merge(&p->counters);
+	if (p->unload) {
+		lvl_free(p->unload);
+		free(p->unload);
+	}
+	struct watch_asset* asset = p->assets;
+	while (asset != NULL) {
+		struct watch_asset* next = asset->next;
+		watch_free_asset(asset);
+		asset = next;
+	}
+}
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-w] [-r] [-s <seed>] [-S <hops>] [--trace <json>] [--record <demo>] <plan|level.lvlb>\n", argv0);
+	fprintf(stderr, "       %s [-w] [-r] [--trace <json>] (--playdemo|--timedemo) <demo>\n", argv0);
+	fprintf(stderr, "  -w          hot reload assets in gfx/, dgfx/ and workbench/\n");
+	fprintf(stderr, "  -r          draw on a render thread, overlapping the next frame\n");
+	fprintf(stderr, "  -S          stream the plan, keeping bricks within this many portals live (not with demos)\n");
+	fprintf(stderr, "  --trace     where F12 and exiting write the trace (TRACE=1 builds)\n");
+	fprintf(stderr, "  --record    record the session's input to a demo\n");
+	fprintf(stderr, "  --playdemo  play a demo back in real time\n");
+	fprintf(stderr, "  --timedemo  play a demo back as fast as possible and report frame times\n");
+	exit(EXIT_FAILURE);
+}
 
 int main(int argc, char** argv)
 {
-	if (argc != 2) {
-		fprintf(stderr, "usage: %s <plan>\n", argv[0]);
-		return EXIT_FAILURE;
+	int watching = 0;
+	int render_thread = 0;
+	uint32_t seed = 1;
+	char* record_path = NULL;
+	char* play_path = NULL;
+	int timedemo = 0;
+	char* trace_path = NULL;
+	int hops = -1;
+
+	int argi = 1;
+	for (; argi < argc && argv[argi][0] == '-'; argi++) {
+		if (strcmp(argv[argi], "-w") == 0) {
+			watching = 1;
+		} else if (strcmp(argv[argi], "-r") == 0) {
+			render_thread = 1;
+		} else if (strcmp(argv[argi], "-s") == 0 && argi+1 < argc) {
+			seed = strtoul(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "-S") == 0 && argi+1 < argc) {
+			hops = atoi(argv[++argi]);
+			if (hops < 0) usage(argv[0]);
+		} else if (strcmp(argv[argi], "--trace") == 0 && argi+1 < argc) {
+			trace_path = argv[++argi];
+		} else if (strcmp(argv[argi], "--record") == 0 && argi+1 < argc) {
+			record_path = argv[++argi];
+		} else if (strcmp(argv[argi], "--playdemo") == 0 && argi+1 < argc) {
+			play_path = argv[++argi];
+		} else if (strcmp(argv[argi], "--timedemo") == 0 && argi+1 < argc) {
+			play_path = argv[++argi];
+			timedemo = 1;
+		} else {
+			usage(argv[0]);
+		}
+	}
+
+	struct demo demo;
+	memset(&demo, 0, sizeof(demo));
+	char* plan;
+	if (play_path) {
+		if (argi != argc || record_path || hops != -1) usage(argv[0]);
+		demo_play(&demo, play_path);
+		plan = demo.plan;
+		seed = demo.seed;
+	} else {
+		if (argi != argc-1) usage(argv[0]);
+		plan = argv[argi];
+		size_t n = strlen(plan);
+		if (hops != -1 && n > 5 && strcmp(plan + n - 5, ".lvlb") == 0) usage(argv[0]);
+		// (demos don't know about streaming)
+		if (hops != -1 && record_path) usage(argv[0]);
+		if (record_path) demo_record(&demo, record_path, plan, seed);
 	}
-	char* plan = argv[1];
 
 	SAZ(SDL_Init(SDL_INIT_VIDEO));
 	atexit(SDL_Quit);
@@ -31,43 +388,67 @@ int main(int argc, char** argv)
 	SDL_GLContext glctx = SDL_GL_CreateContext(window);
 	SAN(glctx);
 
-	SAZ(SDL_GL_SetSwapInterval(1)); // or -1, "late swap tearing"?
+	// (timedemos run as fast as they can)
+	SAZ(SDL_GL_SetSwapInterval(timedemo ? 0 : 1)); // or -1, "late swap tearing"?
 
 	glew_init();
 
-	// get refresh rate
-	SDL_DisplayMode mode;
-	SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode);
-	//printf("refresh rate: %dhz\n", mode.refresh_rate);
-	float dt = 1.0f / (float)mode.refresh_rate;
-	/* ^^^ XXX use refresh rate for dt per default to get a smoother
-	 * experience? allow time() based alternative? */
-
-	struct font font;
-	font_init(&font);
-
-	struct render render;
-	render_init(&render, window);
-
-	struct lvl lvl;
-	lvl_init(&lvl);
-	llvl_build(plan, &lvl);
+	struct gfx gfx;
+	gfx.window = window;
+	font_init(&gfx.font);
+	render_init(&gfx.render, window);
+
+	struct watch watch;
+	if (watching) watch_init(&watch);
+
+	// (frames run, with a loading screen, until the first level is in)
+	struct lvl* lvl = NULL;
+	struct loader loader;
+	int loading = 0;
+	struct world world;
+	int streaming = hops != -1;
+	if (streaming) {
+		// (laying out and building the first bricks is quick)
+		world_init(&world, plan, seed, hops);
+		lvl = world_begin(&world);
+		lvl_begin_tick(lvl);
+	} else {
+		loader_start(&loader, plan, seed);
+		loading = 1;
+	}
 
+	// (the player isn't one of the level's entities)
+	int player_type = names_find_entity_type("player");
 	struct lvl_entity player;
 	memset(&player, 0, sizeof(player));
+	player.type = player_type;
 
 	int exiting = 0;
-	int ctrl_turn_left = 0;
-	int ctrl_turn_right = 0;
-	int ctrl_strafe_left = 0;
-	int ctrl_strafe_right = 0;
-	int ctrl_forward = 0;
-	int ctrl_backward = 0;
-	int overhead_mode = 0;
+	struct input input;
+	memset(&input, 0, sizeof(input));
 
 	SDL_SetRelativeMouseMode(SDL_TRUE);
 
+	struct tick tick;
+	tick_init(&tick);
+	uint64_t n_ticks = 0;
+
+	int overhead_mode = 0;
+
+	int n_frame_times = 0;
+	int reserved_frame_times = 0;
+	uint64_t* frame_times = NULL;
+	uint64_t frequency = SDL_GetPerformanceFrequency();
+	uint64_t frame_start = SDL_GetPerformanceCounter();
+	int show_hud = 0;
+	int dump_trace = 0; // F12 was pressed
+
+	struct rthread rthread;
+	if (render_thread) rthread_start(&rthread, window, glctx, draw_packet, &gfx);
+
 	while (!exiting) {
+		PROF_ZONE("frame");
+
 		SDL_Event e;
 
 		while (SDL_PollEvent(&e)) {
@@ -80,144 +461,191 @@ int main(int argc, char** argv)
 					exiting = 1;
 				}
 				if (e.key.keysym.sym == SDLK_TAB) {
-					overhead_mode = !overhead_mode;
+					input.overhead_mode = !input.overhead_mode;
 				}
-				if (e.key.keysym.sym == SDLK_q) ctrl_turn_left = 1;
-				if (e.key.keysym.sym == SDLK_e) ctrl_turn_right = 1;
-				if (e.key.keysym.sym == SDLK_a) ctrl_strafe_left = 1;
-				if (e.key.keysym.sym == SDLK_d) ctrl_strafe_right = 1;
-				if (e.key.keysym.sym == SDLK_w) ctrl_forward = 1;
-				if (e.key.keysym.sym == SDLK_s) ctrl_backward = 1;
+				if (e.key.keysym.sym == SDLK_F3) {
+					show_hud = !show_hud;
+				}
+				if (e.key.keysym.sym == SDLK_F12) {
+					dump_trace = 1;
+				}
+				if (e.key.keysym.sym == SDLK_F5 && !loading && !streaming && !play_path && !record_path) {
+					// the next seed, built while this one is played
+					loader_start(&loader, plan, ++seed);
+					loading = 1;
+				}
+				if (e.key.keysym.sym == SDLK_q) input.turn_left = 1;
+				if (e.key.keysym.sym == SDLK_e) input.turn_right = 1;
+				if (e.key.keysym.sym == SDLK_a) input.strafe_left = 1;
+				if (e.key.keysym.sym == SDLK_d) input.strafe_right = 1;
+				if (e.key.keysym.sym == SDLK_w) input.forward = 1;
+				if (e.key.keysym.sym == SDLK_s) input.backward = 1;
 
 			}
 
 			if (e.type == SDL_KEYUP) {
-				if (e.key.keysym.sym == SDLK_q) ctrl_turn_left = 0;
-				if (e.key.keysym.sym == SDLK_e) ctrl_turn_right = 0;
-				if (e.key.keysym.sym == SDLK_a) ctrl_strafe_left = 0;
-				if (e.key.keysym.sym == SDLK_d) ctrl_strafe_right = 0;
-				if (e.key.keysym.sym == SDLK_w) ctrl_forward = 0;
-				if (e.key.keysym.sym == SDLK_s) ctrl_backward = 0;
+				if (e.key.keysym.sym == SDLK_q) input.turn_left = 0;
+				if (e.key.keysym.sym == SDLK_e) input.turn_right = 0;
+				if (e.key.keysym.sym == SDLK_a) input.strafe_left = 0;
+				if (e.key.keysym.sym == SDLK_d) input.strafe_right = 0;
+				if (e.key.keysym.sym == SDLK_w) input.forward = 0;
+				if (e.key.keysym.sym == SDLK_s) input.backward = 0;
 			}
 
 			if (e.type == SDL_MOUSEMOTION) {
-				float sensitivity = 0.3f;
-				player.yaw += (float)e.motion.xrel * sensitivity;
-				if (!overhead_mode) {
-					player.pitch += (float)e.motion.yrel * sensitivity;
-					float pitch_limit = 88;
-					if (player.pitch > pitch_limit) player.pitch = pitch_limit;
-					if (player.pitch < -pitch_limit) player.pitch = -pitch_limit;
-				}
+				input.mouse_dx += e.motion.xrel;
+				input.mouse_dy += e.motion.yrel;
 			}
 		}
 
-		if (ctrl_turn_left || ctrl_turn_right) {
-			float turn_speed = 200;
-			float sgn = 0;
-			if (ctrl_turn_left) sgn -= 1.0f;
-			if (ctrl_turn_right) sgn += 1.0f;
-			player.yaw += dt * turn_speed * sgn;
+		struct flat_cache flats;
+		struct lvl* unload = NULL;
+		flat_cache_init(&flats);
+		if (loading && loader_poll(&loader, NULL, NULL)) {
+			unload = lvl;
+			loader_finish(&loader, &lvl, &flats);
+			loading = 0;
+			memset(&player, 0, sizeof(player));
+			player.type = player_type;
+			lvl_begin_tick(lvl);
+			tick_init(&tick);
+			n_ticks = 0;
 		}
 
-		struct vec2 forward;
-		vec2_angle(&forward, player.yaw);
-		struct vec2 right;
-		vec2_normal(&right, &forward);
-
-		if (ctrl_forward || ctrl_backward) {
-			float move_force = 1;
-			float sgn = 0;
-			if (ctrl_forward) sgn -= 1.0f;
-			if (ctrl_backward) sgn += 1.0f;
-			struct vec2 accel;
-			vec2_copy(&accel, &forward);
-			vec2_scalei(&accel, move_force * sgn);
-			lvl_entity_accelerate(&lvl, &player, &accel, dt);
+		// (a timedemo draws every tick, uninterpolated)
+		uint64_t sim_start = SDL_GetPerformanceCounter();
+		int steps = lvl == NULL ? 0 : timedemo ? 1 : tick_frame(&tick);
+		float alpha = timedemo ? 1.0f : tick.alpha;
+		for (int i = 0; i < steps; i++) {
+			/* ticks only see input that went through the demo
+			 * encoding, so recording doesn't change the simulation */
+			struct demo_tick dtick;
+			if (play_path) {
+				if (!demo_read(&demo, &dtick)) {
+					exiting = 1;
+					break;
+				}
+			} else {
+				pack_input(&dtick, &input);
+				if (record_path) demo_write(&demo, &dtick);
+			}
+			struct input tick_input;
+			unpack_input(&tick_input, &dtick);
+			overhead_mode = tick_input.overhead_mode;
+
+			game_tick(lvl, &player, &tick_input, n_ticks++);
+			// (mouse motion goes to the first tick of the frame)
+			input.mouse_dx = 0;
+			input.mouse_dy = 0;
 		}
-
-		if (ctrl_strafe_left || ctrl_strafe_right) {
-			float strafe_force = 0.7;
-			float sgn = 0;
-			if (ctrl_strafe_left) sgn -= 1.0f;
-			if (ctrl_strafe_right) sgn += 1.0f;
-			struct vec2 accel;
-			vec2_copy(&accel, &right);
-			vec2_scalei(&accel, strafe_force * sgn);
-			lvl_entity_accelerate(&lvl, &player, &accel, dt);
+		if (exiting) break;
+
+		if (streaming && steps > 0) {
+			struct lvl* next = world_update(&world, lvl, &player);
+			if (next) {
+				AZ(unload);
+				unload = lvl;
+				lvl = next;
+			}
 		}
 
-		lvl_entity_clipmove(&lvl, &player, dt);
-
+		uint64_t record_start = SDL_GetPerformanceCounter();
+		stats.frame.sim_ms = (float)(record_start - sim_start) * 1000.0f / (float)frequency;
+
+		struct packet* p = frame_alloc(sizeof(*p));
+		memset(p, 0, sizeof(*p));
+		p->lvl = lvl;
+		memcpy(&p->flats, &flats, sizeof(flats));
+		p->unload = unload;
+		p->overhead_mode = overhead_mode;
+		p->texts_tail = &p->texts;
+		if (lvl != NULL) {
+			lvl_entity_lerp(&p->camera, &player, alpha);
+			p->n_entities = lvl->n_entities;
+			p->entities = frame_alloc(lvl->n_entities * sizeof(*p->entities));
+			for (int i = 0; i < lvl->n_entities; i++) {
+				lvl_entity_lerp(&p->entities[i], lvl_get_entity(lvl, i), alpha);
+			}
+			packet_text(p, 6, 6, 3, "score: %d", -1);
+		}
+		if (loading) {
+			const char* stage;
+			float done;
+			loader_poll(&loader, &stage, &done);
+			packet_text(p, 6, lvl ? 12 : 6, 15, "loading: %s %d%%", stage, (int)(done * 100.0f));
+		}
+		p->show_hud = show_hud;
+		if (show_hud) memcpy(&p->stats, &stats, sizeof(p->stats));
+		if (watching) {
+			struct watch_asset** tail = &p->assets;
+			while ((*tail = watch_poll(&watch)) != NULL) tail = &(*tail)->next;
+		}
 
-		// XXX hack to set Z
-		for (int i = 0; i < lvl.n_entities; i++) {
-			struct lvl_entity* e = lvl_get_entity(&lvl, i);
-			if (e->type == ENTITY_DELETED) continue;
-			lvl_entity_clipmove(&lvl, e, dt);
+		/* traces are dumped when no other thread writes zones: not while
+		 * loading, with the watch thread paused, and only while the render
+		 * thread waits */
+		const char* dump_path = NULL;
+		if (dump_trace && !loading) {
+			dump_path = trace_path ? trace_path : "trace.json";
+			dump_trace = 0;
+			if (watching) watch_pause(&watch);
 		}
 
-		if (overhead_mode) {
-			glClearColor(0,0,0,0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); CHKGL;
-			glUseProgram(0);
-			glActiveTexture(GL_TEXTURE0); CHKGL;
-			glDisable(GL_TEXTURE_2D); CHKGL;
-			float overhead_scale = 0.125f;
-			glMatrixMode(GL_PROJECTION);
-			glLoadIdentity();
-			glOrtho(-MAGIC_RWIDTH/2, MAGIC_RWIDTH/2, MAGIC_RHEIGHT/2, -MAGIC_RHEIGHT/2, 1, 0);
-
-			glMatrixMode(GL_MODELVIEW);
-			glLoadIdentity();
-
-			//glTranslatef(0,0,-400);
-			glScalef(overhead_scale, overhead_scale, overhead_scale);
-
-			glColor4f(1,0,0,1);
-			glBegin(GL_LINE_LOOP);
-			for (int i = 0; i < 32; i++) {
-				float r = lvl_entity_radius(&player);
-				float phi = (float)i / 32.0f * 6.2830f;
-				float x = cosf(phi) * r;
-				float y = sinf(phi) * r;
-				glVertex2f(x, y);
-			}
-			glEnd();
-
-			glRotatef(-player.yaw, 0, 0, 1);
-			glTranslatef(-player.position.s[0],-player.position.s[1],0);
-
-			glBegin(GL_LINES);
-			for (int i = 0; i < lvl.n_linedefs; i++) {
-				struct lvl_linedef* l = lvl_get_linedef(&lvl, i);
-				if (l->sidedef[0] == -1 || l->sidedef[1] == -1) {
-					glColor4f(1,1,1,1);
-				} else {
-					glColor4f(0,0.6,0.6,1);
-				}
-				struct vec2* v0 = lvl_get_vertex(&lvl, l->vertex[0]);
-				glVertex2f(v0->s[0], v0->s[1]);
-				struct vec2* v1 = lvl_get_vertex(&lvl, l->vertex[1]);
-				glVertex2f(v1->s[0], v1->s[1]);
-			}
-			glEnd();
+		if (render_thread) {
+			/* (the packet before is drawn once this returns, so the
+			 * frame memory it was in can be reused) */
+			struct packet* drawn = rthread_submit(&rthread, p, dump_path);
+			if (drawn) retire_packet(drawn);
+			frame_flip();
 		} else {
-			render_set_entity_cam(&render, &player);
-			render_lvl(&render, &lvl);
-
-			render_begin2d(&render);
-			font_begin(&font, 6);
-			font_goto(&font, 6, 6);
-			font_color(&font, 3);
-			font_printf(&font, "score: %d", -1);
-			font_end(&font);
-			render_flip(&render);
+			draw_packet(&gfx, p);
+			retire_packet(p);
+			if (dump_path) prof_dump(dump_path);
 		}
+		if (dump_path && watching) watch_resume(&watch);
+
+		uint64_t now = SDL_GetPerformanceCounter();
+		if (timedemo && lvl != NULL) {
+			if (n_frame_times == reserved_frame_times) {
+				reserved_frame_times = reserved_frame_times ? reserved_frame_times * 2 : 4096;
+				frame_times = realloc(frame_times, reserved_frame_times * sizeof(*frame_times));
+				AN(frame_times);
+			}
+			frame_times[n_frame_times++] = now - frame_start;
+		}
+		stats_end_frame((float)(now - frame_start) * 1000.0f / (float)frequency);
+		frame_start = now;
+	}
+
+	if (timedemo) {
+		demo_report(frame_times, n_frame_times, frequency);
+		free(frame_times);
+	}
+	if (play_path || record_path) {
+		printf("demo: %u ticks\n", demo.n_ticks);
+		demo_close(&demo);
+	}
+
+	if (render_thread) {
+		struct packet* drawn = rthread_stop(&rthread);
+		if (drawn) retire_packet(drawn);
+	}
+	if (loading) {
+		// (lvl_build_contours() and friends can't be interrupted)
+		struct lvl* abandoned;
+		struct flat_cache flats;
+		loader_finish(&loader, &abandoned, &flats);
+		flat_cache_free(&flats);
+		lvl_free(abandoned);
+		free(abandoned);
+	}
+	if (streaming) world_free(&world);
 
-		SDL_GL_SwapWindow(window);
+	render_print_stats(&gfx.render);
+	if (trace_path) {
+		// (left paused; it goes with the process)
+		if (watching) watch_pause(&watch);
+		prof_dump(trace_path);
 	}
 
 	SDL_DestroyWindow(window);
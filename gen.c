@@ -0,0 +1,402 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gen.h"
+#include "names.h"
+#include "a.h"
+
+#define OPEN_EAST (1<<0)
+#define OPEN_NORTH (1<<1)
+
+const char* gen_layout_names[] = {
+	"grid",
+	"maze",
+	"spiral",
+	NULL
+};
+
+struct gen {
+	struct gen_params* params;
+	struct lvl* lvl;
+	uint32_t rng;
+
+	int w, h;
+	int32_t* cells; // sector of every cell, or -1
+	uint8_t* open; // OPEN_* towards the cell's east and north neighbours
+	int32_t* vertices; // of every grid point, or -1 until it's used
+
+	int32_t flat, wall;
+};
+
+void gen_params_init(struct gen_params* params)
+{
+	memset(params, 0, sizeof(*params));
+	params->layout = GEN_GRID;
+	params->seed = 1;
+	params->n_cells = 1000;
+}
+
+int gen_find_layout(const char* name)
+{
+	for (int i = 0; gen_layout_names[i]; i++) {
+		if (strcmp(name, gen_layout_names[i]) == 0) return i;
+	}
+	return -1;
+}
+
+// Park-Miller, like the plan builder
+static uint32_t rng_next(struct gen* g)
+{
+	g->rng = (uint64_t)g->rng * 16807 % 2147483647;
+	return g->rng;
+}
+
+static float rng_float(struct gen* g, float lo, float hi)
+{
+	return lo + (hi - lo) * ((float)(rng_next(g) % 1000000) / 1000000.0f);
+}
+
+static int cell_at(struct gen* g, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= g->w || y >= g->h) return -1;
+	return g->cells[x + y * g->w];
+}
+
+static void alloc_cells(struct gen* g, int w, int h)
+{
+	g->w = w;
+	g->h = h;
+	g->cells = malloc(w * h * sizeof(*g->cells));
+	AN(g->cells);
+	for (int i = 0; i < w * h; i++) g->cells[i] = -1;
+	g->open = calloc(w * h, sizeof(*g->open));
+	AN(g->open);
+}
+
+static void open_between(struct gen* g, int x0, int y0, int x1, int y1)
+{
+	int dx = x1 - x0;
+	int dy = y1 - y0;
+	ASSERT(abs(dx) + abs(dy) == 1);
+	if (dx == 1) g->open[x0 + y0 * g->w] |= OPEN_EAST;
+	if (dx == -1) g->open[x1 + y1 * g->w] |= OPEN_EAST;
+	if (dy == 1) g->open[x0 + y0 * g->w] |= OPEN_NORTH;
+	if (dy == -1) g->open[x1 + y1 * g->w] |= OPEN_NORTH;
+}
+
+// the first n cells of a near square grid, in rows
+static void rows_layout(struct gen* g)
+{
+	int n = g->params->n_cells;
+	int w = (int)ceil(sqrt((double)n));
+	alloc_cells(g, w, (n + w - 1) / w);
+	for (int i = 0; i < n; i++) g->cells[i] = i;
+}
+
+static void grid_layout(struct gen* g)
+{
+	rows_layout(g);
+	for (int y = 0; y < g->h; y++) {
+		for (int x = 0; x < g->w; x++) {
+			if (cell_at(g, x, y) == -1) continue;
+			if (cell_at(g, x+1, y) != -1) open_between(g, x, y, x+1, y);
+			if (cell_at(g, x, y+1) != -1) open_between(g, x, y, x, y+1);
+		}
+	}
+}
+
+static const int dirs[4][2] = {{1,0}, {0,1}, {-1,0}, {0,-1}};
+
+// depth first backtracker
+static void maze_layout(struct gen* g)
+{
+	rows_layout(g);
+
+	int n = g->params->n_cells;
+	uint8_t* visited = calloc(n, 1);
+	AN(visited);
+	int32_t* stack = malloc(n * sizeof(*stack));
+	AN(stack);
+
+	int sp = 0;
+	stack[sp++] = 0;
+	visited[0] = 1;
+	while (sp > 0) {
+		int c = stack[sp-1];
+		int x = c % g->w;
+		int y = c / g->w;
+
+		int candidates[4];
+		int n_candidates = 0;
+		for (int d = 0; d < 4; d++) {
+			int nc = cell_at(g, x + dirs[d][0], y + dirs[d][1]);
+			if (nc != -1 && !visited[nc]) candidates[n_candidates++] = d;
+		}
+		if (n_candidates == 0) {
+			sp--;
+			continue;
+		}
+
+		int d = candidates[rng_next(g) % n_candidates];
+		int nx = x + dirs[d][0];
+		int ny = y + dirs[d][1];
+		open_between(g, x, y, nx, ny);
+		int nc = cell_at(g, nx, ny);
+		visited[nc] = 1;
+		stack[sp++] = nc;
+	}
+
+	free(stack);
+	free(visited);
+}
+
+/* (an odd sided square is covered exactly by the spiral, so the corridor
+ * never leaves the grid) */
+static void spiral_layout(struct gen* g)
+{
+	int n = g->params->n_cells;
+	int s = (int)ceil(sqrt((double)n));
+	if ((s & 1) == 0) s++;
+	alloc_cells(g, s, s);
+
+	int x = s/2, y = s/2;
+	int px = 0, py = 0;
+	int d = 0;
+	int i = 0;
+	for (int len = 1; i < n; len++) {
+		for (int k = 0; k < 2 && i < n; k++) {
+			for (int j = 0; j < len && i < n; j++) {
+				ASSERT(x >= 0 && y >= 0 && x < s && y < s);
+				g->cells[x + y * s] = i;
+				if (i > 0) open_between(g, px, py, x, y);
+				px = x;
+				py = y;
+				i++;
+				x += dirs[d][0];
+				y += dirs[d][1];
+			}
+			d = (d + 1) & 3;
+		}
+	}
+}
+
+static int32_t grid_vertex(struct gen* g, int x, int y)
+{
+	int32_t* v = &g->vertices[x + y * (g->w + 1)];
+	if (*v == -1) {
+		*v = lvl_new_vertex(g->lvl);
+		struct vec2* p = lvl_get_vertex(g->lvl, *v);
+		p->s[0] = x * GEN_CELL;
+		p->s[1] = y * GEN_CELL;
+	}
+	return *v;
+}
+
+static int32_t new_vertex(struct gen* g, float x, float y)
+{
+	int32_t vi = lvl_new_vertex(g->lvl);
+	struct vec2* p = lvl_get_vertex(g->lvl, vi);
+	// (level coordinates are kept integral)
+	p->s[0] = rintf(x);
+	p->s[1] = rintf(y);
+	return vi;
+}
+
+static int32_t new_sidedef(struct gen* g, int32_t sector)
+{
+	if (sector == -1) return -1;
+	int32_t sdi = lvl_new_sidedef(g->lvl);
+	struct lvl_sidedef* sd = lvl_get_sidedef(g->lvl, sdi);
+	memset(sd, 0, sizeof(*sd));
+	sd->sector = sector;
+	for (int i = 0; i < 2; i++) {
+		sd->texture[i] = g->wall;
+		mat23_set_identity(&sd->tx[i]);
+	}
+	return sdi;
+}
+
+// the left sector sees v0->v1 going counter-clockwise (sidedef[1])
+static void new_linedef(struct gen* g, int32_t v0, int32_t v1, int32_t left, int32_t right)
+{
+	struct lvl_linedef* ld = lvl_get_linedef(g->lvl, lvl_new_linedef(g->lvl));
+	ld->vertex[0] = v0;
+	ld->vertex[1] = v1;
+	ld->sidedef[1] = new_sidedef(g, left);
+	ld->sidedef[0] = new_sidedef(g, right);
+}
+
+// the grid edge from (x0,y0) to (x1,y1), between two cells (or void)
+static void grid_edge(struct gen* g, int x0, int y0, int x1, int y1, int32_t left, int32_t right, int open)
+{
+	if (left == -1 && right == -1) return;
+	int32_t v0 = grid_vertex(g, x0, y0);
+	int32_t v1 = grid_vertex(g, x1, y1);
+	if (left != -1 && right != -1 && open) {
+		new_linedef(g, v0, v1, left, right);
+	} else {
+		if (left != -1) new_linedef(g, v0, v1, left, -1);
+		if (right != -1) new_linedef(g, v1, v0, right, -1);
+	}
+}
+
+static void new_sector(struct gen* g, float floor_z, float ceiling_z)
+{
+	struct lvl_sector* sector = lvl_get_sector(g->lvl, lvl_new_sector(g->lvl));
+	memset(sector, 0, sizeof(*sector));
+	sector->flat[0].z = floor_z;
+	sector->flat[1].z = ceiling_z;
+	for (int i = 0; i < 2; i++) {
+		sector->flat[i].texture = g->flat;
+		mat23_set_identity(&sector->flat[i].tx);
+	}
+	sector->light_level = rng_float(g, 0.5f, 1.0f);
+	sector->contour0 = -1;
+}
+
+static void build_cells(struct gen* g)
+{
+	int n = g->params->n_cells;
+	for (int i = 0; i < n; i++) {
+		new_sector(g, (rng_next(g) % 3) * 16, 256);
+	}
+
+	g->vertices = malloc((g->w + 1) * (g->h + 1) * sizeof(*g->vertices));
+	AN(g->vertices);
+	for (int i = 0; i < (g->w + 1) * (g->h + 1); i++) g->vertices[i] = -1;
+
+	// vertical edges, going north; the west cell is on the left
+	for (int x = 0; x <= g->w; x++) {
+		for (int y = 0; y < g->h; y++) {
+			int32_t west = cell_at(g, x-1, y);
+			int32_t east = cell_at(g, x, y);
+			int open = west != -1 && (g->open[(x-1) + y * g->w] & OPEN_EAST);
+			grid_edge(g, x, y, x, y+1, west, east, open);
+		}
+	}
+
+	// horizontal edges, going west; the south cell is on the left
+	for (int y = 0; y <= g->h; y++) {
+		for (int x = 0; x < g->w; x++) {
+			int32_t south = cell_at(g, x, y-1);
+			int32_t north = cell_at(g, x, y);
+			int open = south != -1 && (g->open[x + (y-1) * g->w] & OPEN_NORTH);
+			grid_edge(g, x+1, y, x, y, south, north, open);
+		}
+	}
+}
+
+// a square hole in the middle of every pillar_every'th cell
+static void build_pillars(struct gen* g)
+{
+	int every = g->params->pillar_every;
+	if (every <= 0) return;
+
+	float lo = GEN_CELL * 3 / 8;
+	float hi = GEN_CELL * 5 / 8;
+	for (int y = 0; y < g->h; y++) {
+		for (int x = 0; x < g->w; x++) {
+			int32_t sector = cell_at(g, x, y);
+			if (sector == -1 || sector % every != 0) continue;
+			float ox = x * GEN_CELL;
+			float oy = y * GEN_CELL;
+			// clockwise, so the sector around it is on the left
+			int32_t v[4];
+			v[0] = new_vertex(g, ox + lo, oy + lo);
+			v[1] = new_vertex(g, ox + lo, oy + hi);
+			v[2] = new_vertex(g, ox + hi, oy + hi);
+			v[3] = new_vertex(g, ox + hi, oy + lo);
+			for (int i = 0; i < 4; i++) new_linedef(g, v[i], v[(i+1)&3], sector, -1);
+		}
+	}
+}
+
+/* a star with alternating radii, east of the grid; far past the vertex
+ * count flat.c fans or ear clips */
+static void build_polygon(struct gen* g)
+{
+	int n = g->params->polygon_vertices;
+	if (n <= 0) return;
+	if (n < 3) arghf("a polygon needs at least 3 vertices, not %d", n);
+
+	float r = n * 16;
+	if (r < GEN_CELL) r = GEN_CELL;
+	float cx = (g->w + 1) * GEN_CELL + r;
+	float cy = g->h * GEN_CELL / 2;
+
+	int32_t sector = g->lvl->n_sectors;
+	new_sector(g, 0, 512);
+
+	int32_t v0 = g->lvl->n_vertices;
+	for (int i = 0; i < n; i++) {
+		float a = (float)i * 2.0f * (float)M_PI / (float)n;
+		float ri = (i & 1) ? r * 0.75f : r;
+		new_vertex(g, cx + cosf(a) * ri, cy + sinf(a) * ri);
+	}
+	for (int i = 0; i < n; i++) {
+		new_linedef(g, v0 + i, v0 + (i+1) % n, sector, -1);
+	}
+}
+
+// in random cells, away from the pillars
+static void build_entities(struct gen* g)
+{
+	int n = g->params->n_entities;
+	if (n <= 0) return;
+
+	int32_t types[2];
+	types[0] = names_find_entity_type("nightmare");
+	types[1] = names_find_entity_type("nomnom");
+
+	for (int i = 0; i < n; i++) {
+		int x, y;
+		int32_t sector;
+		do {
+			x = rng_next(g) % g->w;
+			y = rng_next(g) % g->h;
+		} while ((sector = cell_at(g, x, y)) == -1);
+
+		struct lvl_entity* e = lvl_get_entity(g->lvl, lvl_new_entity(g->lvl));
+		e->type = types[i & 1];
+		e->position.s[0] = rintf((x + rng_float(g, 0.1f, 0.3f)) * GEN_CELL);
+		e->position.s[1] = rintf((y + rng_float(g, 0.1f, 0.3f)) * GEN_CELL);
+		e->yaw = rng_float(g, 0, 360);
+		e->sector = sector;
+		e->z = lvl_get_sector(g->lvl, sector)->flat[0].z;
+		lvl_entity_begin_tick(e);
+	}
+}
+
+void gen_level(struct gen_params* params, struct lvl* lvl)
+{
+	ASSERT(lvl->n_vertices == 0 && lvl->n_sectors == 0);
+	if (params->n_cells <= 0) arghf("need at least one cell, not %d", params->n_cells);
+
+	struct gen g;
+	memset(&g, 0, sizeof(g));
+	g.params = params;
+	g.lvl = lvl;
+	g.rng = params->seed % 2147483646 + 1;
+	g.flat = names_find_flat("flat0");
+	g.wall = names_find_wall("wall0");
+
+	switch (params->layout) {
+	case GEN_GRID: grid_layout(&g); break;
+	case GEN_MAZE: maze_layout(&g); break;
+	case GEN_SPIRAL: spiral_layout(&g); break;
+	default: arghf("unhandled layout %d", params->layout);
+	}
+
+	build_cells(&g);
+	build_pillars(&g);
+	build_polygon(&g);
+	build_entities(&g);
+
+	lvl->seed = params->seed;
+	lvl_build_contours(lvl);
+
+	free(g.vertices);
+	free(g.open);
+	free(g.cells);
+}
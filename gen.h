@@ -0,0 +1,45 @@
+#ifndef GEN_H
+#define GEN_H
+
+#include <stdint.h>
+
+#include "lvl.h"
+
+/* synthetic stress levels. sectors are the cells of a square grid, GEN_CELL
+ * units wide, and every cell edge becomes either a two-sided linedef (open)
+ * or a pair of one-sided walls:
+ *  GEN_GRID    all cells, all open
+ *  GEN_MAZE    all cells, opened along a random spanning tree
+ *  GEN_SPIRAL  one corridor spiralling out from the middle
+ * on top of that, cells can get a pillar (a hole, so a second contour), and
+ * a single star shaped sector with lots of vertices can be added next to
+ * the grid. the level only depends on the parameters */
+
+#define GEN_CELL (256)
+
+enum gen_layout {
+	GEN_GRID = 0,
+	GEN_MAZE,
+	GEN_SPIRAL,
+	GEN_LAYOUT_N
+};
+
+struct gen_params {
+	enum gen_layout layout;
+	uint32_t seed;
+	int n_cells;
+	int pillar_every; // a pillar in every nth cell, or 0 for none
+	int polygon_vertices; // of the extra star sector, or 0 for none
+	int n_entities;
+};
+
+void gen_params_init(struct gen_params* params);
+
+// -1 if there's no such layout
+int gen_find_layout(const char* name);
+extern const char* gen_layout_names[];
+
+// lvl must be lvl_init()ed and empty; contours are built
+void gen_level(struct gen_params* params, struct lvl* lvl);
+
+#endif/*GEN_H*/
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gpu.h"
+#include "stats.h"
+#include "prof.h"
+#include "a.h"
+
+const char* gpu_pass_names[] = {
+	"gpu_geom",
+	"gpu_entities",
+	"gpu_step",
+	"gpu_blit",
+};
+
+void gpu_timer_init(struct gpu_timer* gt)
+{
+	memset(gt, 0, sizeof(*gt));
+	gt->supported = GLEW_ARB_timer_query;
+	if (!gt->supported) {
+		fprintf(stderr, "no ARB_timer_query; not timing the GPU\n");
+		return;
+	}
+	glGenQueries(GPU_LATENCY * GPU_PASS_N * 2, &gt->queries[0][0][0]); CHKGL;
+}
+
+void gpu_timer_free(struct gpu_timer* gt)
+{
+	if (gt->supported) {
+		glDeleteQueries(GPU_LATENCY * GPU_PASS_N * 2, &gt->queries[0][0][0]); CHKGL;
+	}
+	memset(gt, 0, sizeof(*gt));
+}
+
+static void read_back(struct gpu_timer* gt, int slot)
+{
+	// (queries complete in order, so the last one issued says it all)
+	GLuint last = 0;
+	for (int i = 0; i < GPU_PASS_N; i++) {
+		if (gt->issued[slot][i]) last = gt->queries[slot][i][1];
+	}
+	if (last == 0) return;
+
+	GLuint available = 0;
+	glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available); CHKGL;
+	if (!available) return;
+
+	float frame_ms = 0;
+	for (int i = 0; i < GPU_PASS_N; i++) {
+		if (!gt->issued[slot][i]) continue;
+		GLuint64 t[2];
+		for (int j = 0; j < 2; j++) {
+			glGetQueryObjectui64v(gt->queries[slot][i][j], GL_QUERY_RESULT, &t[j]); CHKGL;
+		}
+		double ms = (double)(t[1] - t[0]) * 1e-6;
+		frame_ms += ms;
+		gt->n[i]++;
+		gt->total_ms[i] += ms;
+		if (ms > gt->worst_ms[i]) gt->worst_ms[i] = ms;
+		#ifdef TRACE
+		prof_track_zone("gpu", gpu_pass_names[i], t[0] + gt->gpu_to_cpu[slot], t[1] + gt->gpu_to_cpu[slot]);
+		#endif
+	}
+	stats_counters->gpu_ms = frame_ms;
+}
+
+void gpu_timer_begin_frame(struct gpu_timer* gt)
+{
+	if (!gt->supported) return;
+
+	int slot = gt->frame % GPU_LATENCY;
+	read_back(gt, slot);
+	memset(gt->issued[slot], 0, sizeof(gt->issued[slot]));
+
+	#ifdef TRACE
+	/* (where "now" is on both clocks; GL_TIMESTAMP doesn't wait for
+	 * the GPU to catch up) */
+	GLint64 gpu_now;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now); CHKGL;
+	gt->gpu_to_cpu[slot] = (int64_t)prof_now() - (int64_t)gpu_now;
+	#endif
+
+	gt->frame++;
+}
+
+static int current_slot(struct gpu_timer* gt)
+{
+	// (begin_frame already moved on)
+	return (gt->frame + GPU_LATENCY - 1) % GPU_LATENCY;
+}
+
+void gpu_timer_begin(struct gpu_timer* gt, enum gpu_pass pass)
+{
+	if (!gt->supported || gt->frame == 0) return;
+	glQueryCounter(gt->queries[current_slot(gt)][pass][0], GL_TIMESTAMP); CHKGL;
+}
+
+void gpu_timer_end(struct gpu_timer* gt, enum gpu_pass pass)
+{
+	if (!gt->supported || gt->frame == 0) return;
+	int slot = current_slot(gt);
+	glQueryCounter(gt->queries[slot][pass][1], GL_TIMESTAMP); CHKGL;
+	gt->issued[slot][pass] = 1;
+}
+
+void gpu_timer_print(struct gpu_timer* gt)
+{
+	if (!gt->supported) return;
+	for (int i = 0; i < GPU_PASS_N; i++) {
+		if (gt->n[i] == 0) continue;
+		printf("%-12s avg %8.3fms  worst %8.3fms  (%u frames)\n",
+			gpu_pass_names[i],
+			gt->total_ms[i] / (double)gt->n[i],
+			gt->worst_ms[i],
+			gt->n[i]);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef GPU_H
+#define GPU_H
+
+#include <stdint.h>
+#include <GL/glew.h>
+
+/* GPU pass timing. every pass gets a GL_TIMESTAMP query at its start and
+ * end. a frame's queries are read back GPU_LATENCY frames later, when its
+ * slot comes around again, and only if the results are in by then; so the
+ * CPU never waits on them (late frames are just dropped). without
+ * ARB_timer_query every call is a no-op */
+
+#define GPU_LATENCY (4) // frames of queries in flight
+
+enum gpu_pass {
+	GPU_GEOM = 0,
+	GPU_ENTITIES,
+	GPU_STEP,
+	GPU_BLIT,
+	GPU_PASS_N
+};
+
+extern const char* gpu_pass_names[];
+
+struct gpu_timer {
+	int supported;
+	uint32_t frame; // frames begun
+
+	GLuint queries[GPU_LATENCY][GPU_PASS_N][2];
+	int issued[GPU_LATENCY][GPU_PASS_N];
+	int64_t gpu_to_cpu[GPU_LATENCY]; // ns to add to GPU timestamps (traces)
+
+	// over all frames read back
+	uint32_t n[GPU_PASS_N];
+	double total_ms[GPU_PASS_N];
+	double worst_ms[GPU_PASS_N];
+};
+
+void gpu_timer_init(struct gpu_timer* gt);
+void gpu_timer_free(struct gpu_timer* gt);
+
+/* reads back the frame that last used the next slot (into the stats of the
+ * frame in progress, and the trace), then starts using it */
+void gpu_timer_begin_frame(struct gpu_timer* gt);
+
+void gpu_timer_begin(struct gpu_timer* gt, enum gpu_pass pass);
+void gpu_timer_end(struct gpu_timer* gt, enum gpu_pass pass);
+
+// per pass averages, to stdout
+void gpu_timer_print(struct gpu_timer* gt);
+
+#endif/*GPU_H*/
@@ -0,0 +1,81 @@
+#include <GL/glew.h>
+
+#include "hud.h"
+#include "stats.h"
+#include "magic.h"
+#include "a.h"
+
+// palette indices (gfx/ref.png)
+#define HUD_TEXT (15)
+#define HUD_GOOD (2)
+#define HUD_BAD (14)
+#define HUD_BUDGET (3)
+
+#define HUD_BUDGET_MS (1000.0f / 60.0f)
+#define HUD_GRAPH_MS (HUD_BUDGET_MS * 2) // at full height
+#define HUD_GRAPH_HEIGHT (48)
+
+/* the screen framebuffer holds palette indices in red (and darkness in
+ * green), like the font shader writes */
+static void index_color(int index)
+{
+	glColor4f((float)index / 255.0f, 0, 0, 1);
+}
+
+static void draw_graph(struct stats* s, int x0, int y0)
+{
+	glUseProgram(0); CHKGL;
+	glActiveTexture(GL_TEXTURE0); CHKGL;
+	glDisable(GL_TEXTURE_2D); CHKGL;
+
+	glBegin(GL_LINES);
+	int n = s->n_frames < STATS_HISTORY ? s->n_frames : STATS_HISTORY;
+	for (int i = 0; i < n; i++) {
+		// oldest first
+		float ms = s->frame_ms[(s->n_frames - n + i) % STATS_HISTORY];
+		float h = ms / HUD_GRAPH_MS * HUD_GRAPH_HEIGHT;
+		if (h > HUD_GRAPH_HEIGHT) h = HUD_GRAPH_HEIGHT;
+		if (h < 1) h = 1;
+		index_color(ms > HUD_BUDGET_MS ? HUD_BAD : HUD_GOOD);
+		glVertex2f(x0 + i + 0.5f, y0);
+		glVertex2f(x0 + i + 0.5f, y0 - h);
+	}
+	float budget = y0 - HUD_BUDGET_MS / HUD_GRAPH_MS * HUD_GRAPH_HEIGHT + 0.5f;
+	index_color(HUD_BUDGET);
+	glVertex2f(x0, budget);
+	glVertex2f(x0 + STATS_HISTORY, budget);
+	glEnd();
+	STATS_ADD(draw_calls, 1);
+}
+
+void hud_draw(struct font* font, struct stats* s)
+{
+	struct stats_frame* f = &s->last;
+
+	font_begin(font, 6);
+	font_color(font, HUD_TEXT);
+
+	int y = 18;
+	font_goto(font, 6, y);
+	font_printf(font, "frame %5.2fms", f->frame_ms);
+	font_goto(font, 6, y += 6);
+	font_printf(font, "sim %.2f render %.2f", f->sim_ms, f->render_ms);
+	font_goto(font, 6, y += 6);
+	if (f->gpu_ms < 0) {
+		font_printf(font, "gpu -");
+	} else {
+		font_printf(font, "gpu %.2f", f->gpu_ms);
+	}
+	font_goto(font, 6, y += 6);
+	font_printf(font, "draws %u binds %u", f->draw_calls, f->texture_binds);
+	font_goto(font, 6, y += 6);
+	font_printf(font, "verts %u idx %u", f->vertices, f->indices);
+	font_goto(font, 6, y += 6);
+	font_printf(font, "tess %u sectors %u ents %u", f->tessellations, f->sectors_visited, f->entities_simulated);
+	font_goto(font, 6, y += 6);
+	font_printf(font, "frame mem %.1fk", (float)f->frame_bytes / 1024.0f);
+
+	font_end(font);
+
+	draw_graph(s, 6, MAGIC_RHEIGHT - 6);
+}
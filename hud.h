@@ -0,0 +1,14 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "font.h"
+#include "stats.h"
+
+/* performance overlay: the last complete frame's stats (stats.h) and a
+ * graph of recent frame times. draws into the screen framebuffer in the 2d
+ * state render_begin2d() sets up, so call it before render_flip(). s is
+ * normally &stats, or a copy of it taken on the main thread */
+
+void hud_draw(struct font* font, struct stats* s);
+
+#endif/*HUD_H*/
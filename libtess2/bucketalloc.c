@@ -174,6 +174,36 @@ void bucketFree( struct BucketAlloc *ba, void *ptr )
 #endif
 }
 
+void resetBucketAlloc( struct BucketAlloc *ba )
+{
+	TESSalloc* alloc = ba->alloc;
+	Bucket *bucket = ba->buckets;
+	Bucket *next;
+	unsigned char* head;
+	unsigned char* it;
+
+	// Release all but the first bucket (the last one in the list).
+	while ( bucket->next )
+	{
+		next = bucket->next;
+		alloc->memfree( alloc->userData, bucket );
+		bucket = next;
+	}
+	ba->buckets = bucket;
+
+	// Rebuild the free list over the remaining bucket.
+	ba->freelist = 0;
+	head = (unsigned char*)bucket + sizeof(Bucket);
+	it = head + ba->itemSize * ba->bucketSize;
+	do
+	{
+		it -= ba->itemSize;
+		*((void**)it) = ba->freelist;
+		ba->freelist = (void*)it;
+	}
+	while ( it != head );
+}
+
 void deleteBucketAlloc( struct BucketAlloc *ba )
 {
 	TESSalloc* alloc = ba->alloc;
@@ -42,6 +42,9 @@ struct BucketAlloc *createBucketAlloc( TESSalloc* alloc, const char *name,
 									  unsigned int itemSize, unsigned int bucketSize );
 void *bucketAlloc( struct BucketAlloc *ba);
 void bucketFree( struct BucketAlloc *ba, void *ptr );
+// Returns all items to the allocator, keeping only its first bucket.
+// Every item must have been freed (or be abandoned) by the caller.
+void resetBucketAlloc( struct BucketAlloc *ba );
 void deleteBucketAlloc( struct BucketAlloc *ba );
 
 #ifdef __cplusplus
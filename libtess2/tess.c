@@ -558,6 +558,46 @@ void tessDeleteTess( TESStesselator *tess )
 	alloc.memfree( alloc.userData, tess );
 }
 
+void tessReset( TESStesselator *tess )
+{
+	struct TESSalloc alloc = tess->alloc;
+
+	if( tess->mesh != NULL ) {
+		tessMeshDeleteMesh( &alloc, tess->mesh );
+		tess->mesh = NULL;
+	}
+	if (tess->vertices != NULL) {
+		alloc.memfree( alloc.userData, tess->vertices );
+		tess->vertices = 0;
+	}
+	if (tess->vertexIndices != NULL) {
+		alloc.memfree( alloc.userData, tess->vertexIndices );
+		tess->vertexIndices = 0;
+	}
+	if (tess->elements != NULL) {
+		alloc.memfree( alloc.userData, tess->elements );
+		tess->elements = 0;
+	}
+
+	// Regions are all returned to the pool when the sweep finishes.
+	resetBucketAlloc( tess->regionPool );
+
+	tess->normal[0] = 0;
+	tess->normal[1] = 0;
+	tess->normal[2] = 0;
+
+	tess->bmin[0] = 0;
+	tess->bmin[1] = 0;
+	tess->bmax[0] = 0;
+	tess->bmax[1] = 0;
+
+	tess->windingRule = TESS_WINDING_ODD;
+
+	tess->outOfMemory = 0;
+	tess->vertexIndexCounter = 0;
+	tess->vertexCount = 0;
+	tess->elementCount = 0;
+}
 
 static TESSindex GetNeighbourFace(TESShalfEdge* edge)
 {
@@ -174,6 +174,15 @@ TESStesselator* tessNewTess( TESSalloc* alloc );
 //   tess - pointer to tesselator object to be deleted.
 void tessDeleteTess( TESStesselator *tess );
 
+// tessReset() - Returns a tesselator to the state tessNewTess() left it in,
+// so it can be reused for the next polygon. Everything allocated since
+// tessNewTess() is released through the allocator, which makes it cheap to
+// pair with an arena allocator whose free is a no-op: rewind the arena to
+// just after tessNewTess() after each reset.
+// Parameters:
+//   tess - pointer to tesselator object to be reset.
+void tessReset( TESStesselator *tess );
+
 // tessAddContour() - Adds a contour to be tesselated.
 // The type of the vertex coordinates is assumed to be TESSreal.
 // Parameters:
@@ -1,3 +1,10 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
@@ -6,6 +13,9 @@
 #include "a.h"
 #include "m.h"
 #include "names.h"
+#include "lvlb.h"
+#include "plan.h"
+#include "prof.h"
 
 static void setup_package_path(lua_State* L)
 {
@@ -307,6 +317,8 @@ static void read_lvl(lua_State* L, struct lvl* lvl, const char* name)
 
 void llvl_load(const char* name, struct lvl* lvl)
 {
+	PROF_ZONE("llvl_load");
+
 	lua_State* L = luaL_newstate();
 
 	luaL_openlibs(L);
@@ -328,7 +340,160 @@ void llvl_load(const char* name, struct lvl* lvl)
 	lua_close(L);
 }
 
-void llvl_build(const char* plan, struct lvl* lvl)
+/* portal_tags[i] is n for linedef i tagged "portal_<n>", or -1. (a linedef
+ * is a portal for at most one tag) */
+static void read_portal_tags(lua_State* L, int32_t* portal_tags, const char* name)
+{
+	lua_getfield(L, -1, "linedefs");
+	int N = lua_objlen(L, -1);
+	for (int i = 1; i <= N; i++) {
+		lua_rawgeti(L, -1, i);
+		portal_tags[i-1] = -1;
+		lua_getfield(L, -1, "tags");
+		if (lua_istable(L, -1)) {
+			int M = lua_objlen(L, -1);
+			for (int j = 1; j <= M; j++) {
+				lua_rawgeti(L, -1, j);
+				int n;
+				if (lua_isstring(L, -1) && sscanf(lua_tostring(L, -1), "portal_%d", &n) == 1) {
+					if (portal_tags[i-1] != -1) arghf("linedef %d has more than one portal tag in '%s'", i, name);
+					portal_tags[i-1] = n;
+				}
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 2);
+	}
+	lua_pop(L, 1);
+}
+
+void llvl_load_brick(const char* name, struct lvl* lvl, int32_t** portal_tags)
+{
+	lua_State* L = luaL_newstate();
+
+	luaL_openlibs(L);
+	setup_package_path(L);
+
+	load_lua_brick(L, name);
+
+	read_lvl(L, lvl, name);
+
+	*portal_tags = malloc(lvl->n_linedefs * sizeof(int32_t));
+	AN(*portal_tags);
+	read_portal_tags(L, *portal_tags, name);
+
+	lvl_build_contours(lvl);
+
+	lua_close(L);
+}
+
+static uint64_t hash_file(uint64_t hash, const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) arghf("%s: %s", path, strerror(errno));
+	char buf[8192];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		hash = lvlb_hash(hash, buf, n);
+	}
+	fclose(f);
+	return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char* s)
+{
+	// (including the terminator, so "ab"+"c" and "a"+"bc" differ)
+	return lvlb_hash(hash, s, strlen(s) + 1);
+}
+
+static uint64_t hash_names(uint64_t hash, const char** names)
+{
+	for (const char** name = names; *name; name++) {
+		hash = hash_string(hash, *name);
+	}
+	return hash_string(hash, "");
+}
+
+/* evaluates the plan with identity shuffle() and pick*() helpers, and pushes
+ * the list of bricks it may reference */
+static void push_plan_bricks(lua_State* L, const char* plan)
+{
+	const char* src =
+		"local plan = ...\n"
+		"function shuffle(list) return list end\n"
+		"function firstn(n, list) return list end\n"
+		"function pickn(n, list) return list end\n"
+		"function pick1(list) return list end\n"
+		"local bricks = {}\n"
+		"local flatten\n"
+		"flatten = function (subtree)\n"
+		"	for _,x in ipairs(subtree) do\n"
+		"		if type(x) == 'table' then\n"
+		"			flatten(x)\n"
+		"		elseif string.sub(x, 1, 1) == '$' then\n"
+		"			table.insert(bricks, string.sub(x, 2))\n"
+		"		end\n"
+		"	end\n"
+		"end\n"
+		"flatten(require('plans/' .. plan)())\n"
+		"return bricks\n";
+	if (luaL_loadstring(L, src) != 0) arghf("(lua) %s", lua_tostring(L, -1));
+	lua_pushstring(L, plan);
+	pcall(L, 1, 1);
+	if (!lua_istable(L, -1)) arghf("expected a brick list for plan \"%s\"", plan);
+}
+
+/* bump when plan.c composes differently, so stale cached builds are
+ * ignored */
+static const uint32_t plan_version = 2;
+
+/* the cache key covers everything that goes into a build: the composition
+ * code, the plan and the bricks it references, and the name tables that
+ * textures and entity types are resolved against */
+static uint64_t plan_hash(const char* plan, uint32_t seed)
+{
+	char path[1024];
+	uint64_t hash = 0;
+
+	hash = hash_string(hash, plan);
+	hash = lvlb_hash(hash, &seed, sizeof(seed));
+
+	hash = lvlb_hash(hash, &plan_version, sizeof(plan_version));
+	hash = hash_file(hash, "lua/build.lua");
+
+	snprintf(path, sizeof(path), "lua/plans/%s.lua", plan);
+	hash = hash_file(hash, path);
+
+	lua_State* L = luaL_newstate();
+	luaL_openlibs(L);
+	setup_package_path(L);
+	push_plan_bricks(L, plan);
+	int N = lua_objlen(L, -1);
+	for (int i = 1; i <= N; i++) {
+		lua_rawgeti(L, -1, i);
+		snprintf(path, sizeof(path), "lua/bricks/%s.lua", lua_tostring(L, -1));
+		hash = hash_string(hash, path);
+		hash = hash_file(hash, path);
+		lua_pop(L, 1);
+	}
+	lua_close(L);
+
+	hash = hash_names(hash, names_flats);
+	hash = hash_names(hash, names_walls);
+	hash = hash_names(hash, names_sprites);
+	hash = hash_names(hash, names_entity_types);
+
+	return hash;
+}
+
+static void report(void (*progress)(void* usr, const char* stage, float done), void* usr, const char* stage, float done)
+{
+	if (progress) progress(usr, stage, done);
+}
+
+/* evaluates a plan with lua/build.lua into p (plan_init()ed here), and
+ * inserts its bricks into lvl, or only places them if lvl is NULL */
+static void compose(const char* plan, uint32_t seed, struct plan* p, struct lvl* lvl, void (*progress)(void* usr, const char* stage, float done), void* usr)
 {
 	lua_State* L = luaL_newstate();
 	luaL_openlibs(L);
@@ -340,15 +505,85 @@ void llvl_build(const char* plan, struct lvl* lvl)
 	if (!lua_isfunction(L, -1)) arghf("expected require('build') to yield a function");
 
 	lua_pushstring(L, plan);
-	pcall(L, 1, 1);
-	if (!lua_istable(L, -1)) arghf("expected require('build')(\"%s\") to yield a table", plan);
+	lua_pushnumber(L, seed);
+	pcall(L, 2, 2);
+	if (!lua_istable(L, -2)) arghf("expected require('build')(\"%s\", %u) to yield a table", plan, seed);
 
-	read_lvl(L, lvl, plan);
+	plan_init(p, lua_tointeger(L, -1));
+	lua_pop(L, 1);
+
+	int N = lua_objlen(L, -1);
+	for (int i = 1; i <= N; i++) {
+		report(progress, usr, "bricks", (float)(i-1) / (float)N);
+		lua_rawgeti(L, -1, i);
+		const char* thing = lua_tostring(L, -1);
+		if (thing == NULL) arghf("expected plan \"%s\" entry %d to be a string", plan, i);
+		switch (thing[0]) {
+			case '$':
+				if (lvl) {
+					plan_insert_brick(p, lvl, thing + 1);
+				} else {
+					plan_place_brick(p, thing + 1);
+				}
+				break;
+			default:
+				arghf("unhandled plan entry \"%s\" in \"%s\"", thing, plan);
+				break;
+		}
+		lua_pop(L, 1);
+	}
 
-	lvl_build_contours(lvl);
 	lua_close(L);
 }
 
+static void llvl_build_plan(const char* plan, uint32_t seed, struct lvl* lvl, void (*progress)(void* usr, const char* stage, float done), void* usr)
+{
+	struct plan p;
+	compose(plan, seed, &p, lvl, progress, usr);
+	plan_free(&p);
+
+	lvl->seed = seed;
+	report(progress, usr, "contours", 0);
+	lvl_build_contours(lvl);
+}
+
+void llvl_layout(const char* plan, uint32_t seed, struct plan* p)
+{
+	PROF_ZONE("llvl_layout");
+	compose(plan, seed, p, NULL, NULL, NULL);
+}
+
+void llvl_build(const char* plan, uint32_t seed, struct lvl* lvl)
+{
+	llvl_build_progress(plan, seed, lvl, NULL, NULL);
+}
+
+void llvl_build_progress(const char* plan, uint32_t seed, struct lvl* lvl, void (*progress)(void* usr, const char* stage, float done), void* usr)
+{
+	PROF_ZONE("llvl_build");
+
+	char path[1024];
+	report(progress, usr, "hashing", 0);
+	snprintf(path, sizeof(path), "%s/%016llx.lvlb", LLVL_CACHE_DIR, (unsigned long long)plan_hash(plan, seed));
+
+	struct lvl cached;
+	report(progress, usr, "loading", 0);
+	if (lvlb_load(path, &cached) == 0) {
+		lvl_free(lvl);
+		memcpy(lvl, &cached, sizeof(struct lvl));
+		return;
+	}
+
+	llvl_build_plan(plan, seed, lvl, progress, usr);
+
+	report(progress, usr, "caching", 0);
+	if (mkdir(LLVL_CACHE_DIR, 0777) == -1 && errno != EEXIST) {
+		fprintf(stderr, "not caching %s: mkdir(%s): %s\n", plan, LLVL_CACHE_DIR, strerror(errno));
+		return;
+	}
+	lvlb_save(path, lvl);
+}
+
 static void push_tx(lua_State* L, struct mat23* tx)
 {
 	lua_newtable(L);
@@ -2,9 +2,24 @@
 #define LLVL_H
 
 #include "lvl.h"
+#include "plan.h"
 
 void llvl_load(const char* name, struct lvl* lvl);
 void llvl_save(const char* name, struct lvl* lvl);
-void llvl_build(const char* plan, struct lvl* lvl);
+
+/* llvl_load() that also returns n for every linedef tagged "portal_<n>",
+ * or -1 for untagged linedefs; free *portal_tags when done */
+void llvl_load_brick(const char* name, struct lvl* lvl, int32_t** portal_tags);
+/* builds a plan with lua/build.lua; the same plan and seed always yield the
+ * same level. results are cached as compiled levels in LLVL_CACHE_DIR, keyed
+ * by a hash of everything the build depends on */
+#define LLVL_CACHE_DIR "cache"
+void llvl_build(const char* plan, uint32_t seed, struct lvl* lvl);
+/* llvl_build() that tells progress() (on the calling thread) which step
+ * it's on, and how far along that step is, from 0 to 1 */
+void llvl_build_progress(const char* plan, uint32_t seed, struct lvl* lvl, void (*progress)(void* usr, const char* stage, float done), void* usr);
+/* places a plan's bricks (the same as llvl_build() would) without building
+ * the level; plan_free() p when done */
+void llvl_layout(const char* plan, uint32_t seed, struct plan* p);
 
 #endif//LLVL_H
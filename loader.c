@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "llvl.h"
+#include "lvlb.h"
+#include "prof.h"
+#include "a.h"
+
+static void loader_progress(void* usr, const char* stage, float done)
+{
+	struct loader* ld = usr;
+	SAZ(SDL_LockMutex(ld->mutex));
+	ld->stage = stage;
+	ld->done = done;
+	SAZ(SDL_UnlockMutex(ld->mutex));
+}
+
+static int is_lvlb(const char* plan)
+{
+	size_t n = strlen(plan);
+	return n > 5 && strcmp(plan + n - 5, ".lvlb") == 0;
+}
+
+static int loader_run(void* usr)
+{
+	struct loader* ld = usr;
+	PROF_THREAD_BEGIN("loader");
+	stats_counters = &ld->counters;
+
+	if (is_lvlb(ld->plan)) {
+		loader_progress(ld, "loading", 0);
+		if (lvlb_load(ld->plan, ld->lvl) == -1) arghf("%s: missing or invalid compiled level", ld->plan);
+	} else {
+		lvl_init(ld->lvl);
+		llvl_build_progress(ld->plan, ld->seed, ld->lvl, loader_progress, ld);
+	}
+
+	loader_progress(ld, "flats", 0);
+	flat_cache_update(&ld->flats, ld->lvl);
+
+	loader_progress(ld, "done", 1);
+	SAZ(SDL_LockMutex(ld->mutex));
+	ld->finished = 1;
+	SAZ(SDL_UnlockMutex(ld->mutex));
+
+	PROF_THREAD_END();
+	return 0;
+}
+
+void loader_start(struct loader* ld, const char* plan, uint32_t seed)
+{
+	memset(ld, 0, sizeof(*ld));
+	ld->plan = plan;
+	ld->seed = seed;
+	ld->lvl = malloc(sizeof(*ld->lvl));
+	AN(ld->lvl);
+	flat_cache_init(&ld->flats);
+	stats_reset_frame(&ld->counters);
+	ld->stage = "starting";
+
+	ld->mutex = SDL_CreateMutex();
+	SAN(ld->mutex);
+
+	ld->thread = SDL_CreateThread(loader_run, "loader", ld);
+	SAN(ld->thread);
+}
+
+int loader_poll(struct loader* ld, const char** stage, float* done)
+{
+	SAZ(SDL_LockMutex(ld->mutex));
+	int finished = ld->finished;
+	if (stage) *stage = ld->stage;
+	if (done) *done = ld->done;
+	SAZ(SDL_UnlockMutex(ld->mutex));
+	return finished;
+}
+
+void loader_finish(struct loader* ld, struct lvl** lvl, struct flat_cache* flats)
+{
+	SDL_WaitThread(ld->thread, NULL);
+	SDL_DestroyMutex(ld->mutex);
+
+	*lvl = ld->lvl;
+	memcpy(flats, &ld->flats, sizeof(*flats));
+	memset(ld, 0, sizeof(*ld));
+}
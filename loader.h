@@ -0,0 +1,40 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <SDL.h>
+
+#include "lvl.h"
+#include "flat.h"
+#include "stats.h"
+
+/* builds a level on a background thread, so the window stays responsive
+ * while bricks are composed and contours built. the level's flats are
+ * tessellated there too (see render_adopt_flats()), so the frame that
+ * swaps it in doesn't stall. the main thread polls for progress; only one
+ * load runs at a time */
+
+struct loader {
+	SDL_Thread* thread;
+	const char* plan; // a plan name, or a .lvlb path (kept by pointer)
+	uint32_t seed;
+
+	struct lvl* lvl;
+	struct flat_cache flats;
+	struct stats_frame counters; // (the loader thread's; not shown)
+
+	SDL_mutex* mutex;
+	const char* stage;
+	float done;
+	int finished;
+};
+
+void loader_start(struct loader* ld, const char* plan, uint32_t seed);
+
+// 1 once the level is ready; stage/done (if not NULL) say how far it got
+int loader_poll(struct loader* ld, const char** stage, float* done);
+
+/* waits for the level, and hands it over: *lvl is malloc()ed, and flats
+ * should go to render_adopt_flats() */
+void loader_finish(struct loader* ld, struct lvl** lvl, struct flat_cache* flats);
+
+#endif/*LOADER_H*/
@@ -1,6 +1,20 @@
-local vec2 = require('vec2')
-local mat33 = require('mat33')
-local mat44 = require('mat44')
+-- plan evaluation. a plan is a (nested) list of things to build, currently
+-- only bricks ("$name"); the bricks are composed into a level in C (plan.c)
+
+-- Park-Miller "minimal standard" generator; self-contained so a plan+seed
+-- builds the same level regardless of the host's math.random(). (products
+-- stay below 2^46, so they're exact in doubles.) plan.c continues the
+-- sequence, so keep the two in sync
+local rng_state = 1
+
+local seed_random = function (seed)
+	rng_state = seed % 2147483646 + 1
+end
+
+local random = function (lo, hi)
+	rng_state = (rng_state * 16807) % 2147483647
+	return lo + rng_state % (hi - lo + 1)
+end
 
 function shuffle(list)
 	local copy = {}
@@ -9,7 +23,7 @@ function shuffle(list)
 	end
 	local n = #copy
 	for i = 1,n do
-		local j = math.random(i,n)
+		local j = random(i,n)
 		local tmp = copy[j]
 		copy[j] = copy[i]
 		copy[i] = tmp
@@ -33,180 +47,22 @@ function pick1(list)
 end
 
 
-return function (plan_id)
-	local load_plan = function (id)
-		local list = {}
-		local flatten
-		flatten = function (subtree)
-			for _,x in ipairs(subtree) do
-				if type(x) == "table" then
-					flatten(x)
-				else
-					table.insert(list, x)
-				end
-			end
-		end
-		flatten(require('plans/' .. id)())
-		return list
-	end
-
-	local pick_portal = function(target, n)
-		local portals = {}
-		local match_tag = "portal_" .. n
-		for ldi,ld in ipairs(target.linedefs) do
-			for _,tag in ipairs(ld.tags or {}) do
-				if tag == match_tag then
-					if ld.sidedef[1] and ld.sidedef[2] then
-						error("two-sided linedef cannot be a portal")
-					end
-					table.insert(portals, ldi)
-					break
-				end
-			end
-		end
-		if #portals == 0 then error("no portals in target") end
-		local i = pick1(portals)
-		local new_tags = {}
-		for _,tag in ipairs(target.linedefs[i].tags) do
-			if tag ~= match_tag then
-				table.insert(new_tags, tag)
-			end
-		end
-		target.linedefs[i].tags = new_tags
-		return i
-	end
-
-	local lvl = {
-		vertices = {},
-		linedefs = {},
-		sidedefs = {},
-		sectors = {},
-		entities = {},
-
-		add_initial_brick = function (self, brick)
-			self.vertices = brick.vertices
-			self.linedefs = brick.linedefs
-			self.sidedefs = brick.sidedefs
-			self.sectors = brick.sectors
-			self.entities = brick.entities
-		end,
+-- returns the flattened plan, and the generator state to continue from
+return function (plan_id, seed)
+	seed_random(seed or 1)
 
-		insert_brick = function (self, brick)
-			if #self.vertices == 0 then
-				return self:add_initial_brick(brick)
+	local list = {}
+	local flatten
+	flatten = function (subtree)
+		for _,x in ipairs(subtree) do
+			if type(x) == "table" then
+				flatten(x)
 			else
-				local t = 0
-
-				local pick = function(target, side)
-					local portal = pick_portal(target, t)
-					local ld = target.linedefs[portal]
-					local s = 0
-					local z0 = nil
-					if ld.sidedef[2] then
-						s=1
-						z0 = target.sectors[target.sidedefs[ld.sidedef[2]].sector].flat[1].z
-					else
-						z0 = target.sectors[target.sidedefs[ld.sidedef[1]].sector].flat[1].z
-					end
-					local i0 = (side+s)%2
-					local i1 = (side+s+1)%2
-					local v0i = ld.vertex[i0+1]
-					local v1i = ld.vertex[i1+1]
-					return v0i, v1i, portal, z0
-				end
-
-				local sv0i, sv1i, sportal, sz0 = pick(self, 0)
-				local bv0i, bv1i, bportal, bz0 = pick(brick, 1)
-
-				local sv0 = self.vertices[sv0i]
-				local sv1 = self.vertices[sv1i]
-				local bv0 = brick.vertices[bv0i]
-				local bv1 = brick.vertices[bv1i]
-
-				local tx = mat33.homogeneous_map33(bv0, bv1, sv0, sv1)
-				local dz = sz0 - bz0
-
-				local sidedef_offset = #self.sidedefs
-				local sector_offset = #self.sectors
-
-				local vertex_map = {[bv0i]=sv0i,[bv1i]=sv1i}
-				for i = 1,#brick.vertices do
-					if i ~= bv0i and i ~= bv1i then
-						table.insert(self.vertices, tx:homogeneous_apply(brick.vertices[i]))
-						vertex_map[i] = #self.vertices
-					end
-				end
-
-				for ldi,ld in ipairs(brick.linedefs) do
-					if ldi == bportal then
-						local sld = self.linedefs[sportal]
-						local c = 0
-						for a=1,2 do
-							for b=1,2 do
-								if not sld.sidedef[a] and ld.sidedef[b] then
-									sld.sidedef[a] = ld.sidedef[b] + sidedef_offset
-									c = c + 1
-								end
-							end
-						end
-						if c ~= 1 then error("expected exactly one replacement") end
-					else
-						for i = 1,2 do
-							ld.vertex[i] = vertex_map[ld.vertex[i]]
-							if not ld.vertex[i] then error("vertex_map contains nil") end
-							if ld.sidedef[i] then
-								ld.sidedef[i] = ld.sidedef[i] + sidedef_offset
-							end
-						end
-						table.insert(self.linedefs, ld)
-					end
-				end
-				for _,sd in ipairs(brick.sidedefs) do
-					sd.sector = sd.sector + sector_offset
-					-- TODO texture transform (z only?)
-					table.insert(self.sidedefs, sd)
-				end
-				for _,sector in ipairs(brick.sectors) do
-					-- TODO texture transform
-					for flati=1,2 do
-						local flat = sector.flat[flati]
-						flat.z = flat.z + dz
-					end
-					table.insert(self.sectors, sector)
-				end
-				for _,entity in ipairs(brick.entities) do
-					entity.position = tx:homogeneous_apply(entity.position)
-					entity.yaw = entity.yaw + tx:homogeneous_calculate_rotation()
-					table.insert(self.entities, entity)
-				end
-				-- (NOTE first sidedef is left, second is right)
+				table.insert(list, x)
 			end
 		end
-	}
-
-	local insert_brick = function (name)
-		local brick = dofile("lua/bricks/" .. name .. ".lua")
-
-		-- bless vertices
-		for i = 1,#brick.vertices do brick.vertices[i] = vec2(brick.vertices[i]) end
-
-		lvl:insert_brick(brick)
-
 	end
+	flatten(require('plans/' .. plan_id)())
 
-	for _,thing in ipairs(load_plan(plan_id)) do
-		local handlers = {
-			["$"] = insert_brick
-		}
-		handlers[string.sub(thing, 1, 1)](string.sub(thing, 2))
-	end
-
-	--[[
-	print("vertices: " .. #lvl.vertices)
-	print("linedefs: " .. #lvl.linedefs)
-	print("sidedefs: " .. #lvl.sidedefs)
-	print("sectors: " .. #lvl.sectors)
-	]]
-
-	return lvl
+	return list, rng_state
 end
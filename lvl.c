@@ -2,10 +2,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <sys/mman.h>
 
 #include "a.h"
 #include "lvl.h"
 #include "magic.h"
+#include "prof.h"
+#include "stats.h"
+
+uint32_t lvl_next_generation(void)
+{
+	// (levels are set up on the loader thread too)
+	static uint32_t generation;
+	return __sync_add_and_fetch(&generation, 1);
+}
 
 void lvl_init(struct lvl* lvl)
 {
@@ -17,6 +27,7 @@ void lvl_init(struct lvl* lvl)
 	#endif
 
 	memset(lvl, 0, sizeof(struct lvl));
+	lvl->generation = lvl_next_generation();
 
 	const int more_than_I_will_ever_need = 32768;
 
@@ -39,6 +50,75 @@ void lvl_init(struct lvl* lvl)
 	lvl->entities = calloc(lvl->reserved_entities, sizeof(struct lvl_entity));
 }
 
+static void idset_free(struct lvl_idset* set)
+{
+	free(set->ids);
+	free(set->flags);
+	free(set->index);
+	memset(set, 0, sizeof(*set));
+}
+
+void lvl_free(struct lvl* lvl)
+{
+	idset_free(&lvl->tags.sectors);
+	idset_free(&lvl->tags.sidedefs);
+	idset_free(&lvl->tags.dirty_sectors);
+	idset_free(&lvl->tags.dirty_sidedefs);
+
+	if (lvl->_mapping) {
+		AZ(munmap(lvl->_mapping, lvl->_mapping_sz));
+	} else {
+		free(lvl->sectors);
+		free(lvl->linedefs);
+		free(lvl->sidedefs);
+		free(lvl->vertices);
+		free(lvl->contours);
+		free(lvl->entities);
+	}
+	memset(lvl, 0, sizeof(struct lvl));
+}
+
+/* moves a compiled level's arrays out of the (fixed size) mapping and onto
+ * the heap, so they can grow */
+static void lvl_detach(struct lvl* lvl)
+{
+	#define DETACH(name) { \
+		size_t sz = lvl->reserved_##name * sizeof(*lvl->name); \
+		void* data = malloc(sz); \
+		AN(data); \
+		memcpy(data, lvl->name, sz); \
+		lvl->name = data; \
+	}
+	DETACH(sectors)
+	DETACH(linedefs)
+	DETACH(sidedefs)
+	DETACH(vertices)
+	DETACH(contours)
+	DETACH(entities)
+	#undef DETACH
+
+	AZ(munmap(lvl->_mapping, lvl->_mapping_sz));
+	lvl->_mapping = NULL;
+	lvl->_mapping_sz = 0;
+}
+
+/* grows an array geometrically to hold at least n elements. pointers into
+ * the array are invalidated when it grows */
+static void lvl_reserve(struct lvl* lvl, void** data, uint32_t* reserved, uint32_t n, size_t elem_sz)
+{
+	if (n <= *reserved) return;
+	if (lvl->_mapping) lvl_detach(lvl);
+	uint32_t r = *reserved ? *reserved : 16;
+	while (r < n) r *= 2;
+	*data = realloc(*data, r * elem_sz);
+	AN(*data);
+	memset((uint8_t*)*data + *reserved * elem_sz, 0, (r - *reserved) * elem_sz);
+	*reserved = r;
+}
+
+#define LVL_RESERVE(lvl, name, n) \
+	lvl_reserve(lvl, (void**)&(lvl)->name, &(lvl)->reserved_##name, n, sizeof(*(lvl)->name))
+
 static void lvl_entity_init(struct lvl_entity* e)
 {
 	memset(e, 0, sizeof(struct lvl_entity));
@@ -47,7 +127,7 @@ static void lvl_entity_init(struct lvl_entity* e)
 
 uint32_t lvl_new_entity(struct lvl* lvl)
 {
-	ASSERT(lvl->n_entities < lvl->reserved_entities);
+	LVL_RESERVE(lvl, entities, lvl->n_entities + 1);
 	uint32_t newi = lvl->n_entities++;
 	lvl_entity_init(lvl_get_entity(lvl, newi));
 	return newi;
@@ -70,7 +150,7 @@ static void lvl_sector_init(struct lvl_sector* sector)
 
 uint32_t lvl_new_sector(struct lvl* lvl)
 {
-	ASSERT(lvl->n_sectors < lvl->reserved_sectors);
+	LVL_RESERVE(lvl, sectors, lvl->n_sectors + 1);
 	uint32_t newi = lvl->n_sectors++;
 	lvl_sector_init(lvl_get_sector(lvl, newi));
 	return newi;
@@ -91,7 +171,7 @@ static void lvl_linedef_init(struct lvl_linedef* linedef)
 
 uint32_t lvl_new_linedef(struct lvl* lvl)
 {
-	ASSERT(lvl->n_linedefs < lvl->reserved_linedefs);
+	LVL_RESERVE(lvl, linedefs, lvl->n_linedefs + 1);
 	uint32_t newi = lvl->n_linedefs++;
 	lvl_linedef_init(lvl_get_linedef(lvl, newi));
 	return newi;
@@ -112,7 +192,7 @@ static void lvl_sidedef_init(struct lvl_sidedef* sidedef)
 
 uint32_t lvl_new_sidedef(struct lvl* lvl)
 {
-	ASSERT(lvl->n_sidedefs < lvl->reserved_sidedefs);
+	LVL_RESERVE(lvl, sidedefs, lvl->n_sidedefs + 1);
 	uint32_t newi = lvl->n_sidedefs++;
 	lvl_sidedef_init(lvl_get_sidedef(lvl, newi));
 	return newi;
@@ -126,7 +206,7 @@ struct lvl_sidedef* lvl_get_sidedef(struct lvl* lvl, int32_t i)
 
 uint32_t lvl_new_vertex(struct lvl* lvl)
 {
-	ASSERT(lvl->n_vertices < lvl->reserved_vertices);
+	LVL_RESERVE(lvl, vertices, lvl->n_vertices + 1);
 	return lvl->n_vertices++;
 }
 
@@ -150,7 +230,7 @@ struct lvl_contour* lvl_get_contour(struct lvl* lvl, int32_t i)
 
 static void add_contour(struct lvl* lvl, uint32_t linedef, uint32_t usr)
 {
-	ASSERT((lvl->n_contours + 1) < lvl->reserved_contours);
+	LVL_RESERVE(lvl, contours, lvl->n_contours + 1);
 	int32_t i = lvl->n_contours++;
 	struct lvl_contour* contour = lvl_get_contour(lvl, i);
 	contour->linedef = linedef;
@@ -376,9 +456,15 @@ void lvl_entity_update_sector(struct lvl* lvl, struct lvl_entity* entity)
 	entity->sector = -1;
 }
 
+#define ENTDEF(group,type,radius,height,draw,art,flags,think) {radius, height, ENTITY_DRAW_##draw, flags, think, art},
+const struct lvl_entity_type lvl_entity_types[] = {
+	#include "entities.inc.h"
+};
+#undef ENTDEF
+
 float lvl_entity_radius(struct lvl_entity* entity)
 {
-	return 32; // XXX? TODO get from entities.inc.h
+	return lvl_entity_type(entity)->radius;
 }
 
 static void lvl_entity_vec3_position(struct lvl_entity* entity, struct vec3* position)
@@ -489,7 +575,7 @@ static void entclip_sector_contour(struct clip_result* result, struct lvl* lvl,
 			struct lvl_sector* sector = lvl_get_sector(lvl, sopp->sector);
 
 			float headroom = sector->flat[1].z - sector->flat[0].z;
-			if (headroom < MAGIC_EVEN_MORE_MAGIC_ENTITY_HEIGHT) impassable = 1;
+			if (headroom < lvl_entity_type(entity)->height) impassable = 1;
 		}
 
 		if (impassable) {
@@ -500,6 +586,7 @@ static void entclip_sector_contour(struct clip_result* result, struct lvl* lvl,
 
 static void entclip_sector(struct clip_result* result, struct lvl* lvl, struct lvl_entity* entity, int32_t sectori)
 {
+	STATS_ADD(sectors_visited, 1);
 	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
 
 	for (int i = 0; i < sector->contourn; i++) {
@@ -527,6 +614,9 @@ void lvl_entity_accelerate(struct lvl* lvl, struct lvl_entity* entity, struct ve
 
 void lvl_entity_clipmove(struct lvl* lvl, struct lvl_entity* entity, float dt)
 {
+	PROF_ZONE("lvl_entity_clipmove");
+	STATS_ADD(entities_simulated, 1);
+
 	// apply friction
 	vec2_scalei(&entity->velocity, powf(MAGIC_FRICTION_MAGNITUDE, dt));
 	if (vec2_dot(&entity->velocity, &entity->velocity) < MAGIC_STOP_THRESHOLD) {
@@ -537,19 +627,25 @@ void lvl_entity_clipmove(struct lvl* lvl, struct lvl_entity* entity, float dt)
 	vec2_copy(&move, &entity->velocity);
 	vec2_scalei(&move, dt);
 
-	float move_length = vec2_length(&move);
+	const struct lvl_entity_type* type = lvl_entity_type(entity);
 
-	int nsteps = (int)ceilf(move_length/(lvl_entity_radius(entity)/64));
-	if (nsteps < 1) nsteps = 1;
-	float fragment = 1.0f / (float)nsteps;
+	if (type->flags & ENTITY_CLIPS) {
+		float move_length = vec2_length(&move);
 
-	for (int i = 0; i < nsteps; i++) {
-		struct vec2 move_fragment;
-		vec2_scale(&move_fragment, &move, fragment);
-		vec2_addi(&entity->position, &move_fragment);
+		int nsteps = (int)ceilf(move_length/(type->radius/64));
+		if (nsteps < 1) nsteps = 1;
+		float fragment = 1.0f / (float)nsteps;
 
-		struct clip_result clip_result;
-		entclip(&clip_result, lvl, entity);
+		for (int i = 0; i < nsteps; i++) {
+			struct vec2 move_fragment;
+			vec2_scale(&move_fragment, &move, fragment);
+			vec2_addi(&entity->position, &move_fragment);
+
+			struct clip_result clip_result;
+			entclip(&clip_result, lvl, entity);
+		}
+	} else {
+		vec2_addi(&entity->position, &move);
 	}
 
 
@@ -558,10 +654,40 @@ void lvl_entity_clipmove(struct lvl* lvl, struct lvl_entity* entity, float dt)
 	// XXX updating z here, but that's not how all entities work (or eventually any)
 	if (entity->sector != -1) {
 		struct lvl_sector* sector = lvl_get_sector(lvl, entity->sector);
-		float height = MAGIC_EVEN_MORE_MAGIC_ENTITY_HEIGHT;
-		entity->z = sector->flat[0].z + height;
+		entity->z = sector->flat[0].z + type->height;
+	}
+
+}
+
+void lvl_entity_begin_tick(struct lvl_entity* entity)
+{
+	vec2_copy(&entity->prev_position, &entity->position);
+	entity->prev_z = entity->z;
+	entity->prev_yaw = entity->yaw;
+	entity->prev_pitch = entity->pitch;
+}
+
+void lvl_begin_tick(struct lvl* lvl)
+{
+	for (int i = 0; i < lvl->n_entities; i++) {
+		lvl_entity_begin_tick(lvl_get_entity(lvl, i));
 	}
+}
 
+static float lerpf(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+void lvl_entity_lerp(struct lvl_entity* dst, struct lvl_entity* src, float alpha)
+{
+	memcpy(dst, src, sizeof(*dst));
+	for (int i = 0; i < 2; i++) {
+		dst->position.s[i] = lerpf(src->prev_position.s[i], src->position.s[i], alpha);
+	}
+	dst->z = lerpf(src->prev_z, src->z, alpha);
+	dst->yaw = lerpf(src->prev_yaw, src->yaw, alpha);
+	dst->pitch = lerpf(src->prev_pitch, src->pitch, alpha);
 }
 
 int lvl_trace(
@@ -571,6 +697,8 @@ int lvl_trace(
 	struct vec3* ray,
 	struct lvl_trace_result* result)
 {
+	PROF_ZONE("lvl_trace");
+
 	struct vec3 origin;
 	vec3_copy(&origin, originp);
 
@@ -595,6 +723,7 @@ int lvl_trace(
 
 		struct lvl_sector* sector = lvl_get_sector(lvl, result->sector);
 		struct lvl_contour* nc = NULL;
+		STATS_ADD(sectors_visited, 1);
 
 		int n = 0;
 
@@ -688,126 +817,201 @@ int lvl_trace(
 	return 0;
 }
 
-static void lvl_tag_apply_mask(struct lvl* lvl, int32_t mask)
+int lvl_idset_has(struct lvl_idset* set, int32_t id)
 {
-	for (int i = 0; i < lvl->n_sectors; i++) {
-		struct lvl_sector* sector = lvl_get_sector(lvl, i);
-		sector->usr &= mask;
-		for (int j = 0; j < sector->contourn; j++) {
-			int32_t ci = sector->contour0 + j;
-			struct lvl_contour* c = lvl_get_contour(lvl, ci);
-			struct lvl_linedef* ld = lvl_get_linedef(lvl, c->linedef);
-			uint32_t sdi = ld->sidedef[c->usr&1];
-			ASSERT(sdi != -1);
-			struct lvl_sidedef* sd = lvl_get_sidedef(lvl, sdi);
-			sd->usr &= mask;
+	if (id < 0 || id >= set->reserved_index) return 0;
+	uint32_t i = set->index[id];
+	return i < set->n && set->ids[i] == id;
+}
+
+uint32_t lvl_idset_get(struct lvl_idset* set, int32_t id)
+{
+	return lvl_idset_has(set, id) ? set->flags[set->index[id]] : 0;
+}
+
+static void idset_grow(void** data, uint32_t* reserved, uint32_t n, size_t elem_sz)
+{
+	if (n <= *reserved) return;
+	uint32_t r = *reserved ? *reserved : 64;
+	while (r < n) r *= 2;
+	*data = realloc(*data, r * elem_sz);
+	AN(*data);
+	*reserved = r;
+}
+
+// flags == 0 removes the id
+static void idset_put(struct lvl_idset* set, int32_t id, uint32_t flags)
+{
+	ASSERT(id >= 0);
+	if (lvl_idset_has(set, id)) {
+		uint32_t i = set->index[id];
+		if (flags) {
+			set->flags[i] = flags;
+		} else {
+			// swap in the last member
+			uint32_t last = --set->n;
+			set->ids[i] = set->ids[last];
+			set->flags[i] = set->flags[last];
+			set->index[set->ids[i]] = i;
 		}
+		return;
+	}
+	if (flags == 0) return;
+
+	// (the index doesn't need clearing; membership is checked against ids)
+	idset_grow((void**)&set->index, &set->reserved_index, id + 1, sizeof(*set->index));
+	if (set->n == set->reserved) {
+		uint32_t r = set->reserved ? set->reserved * 2 : 64;
+		set->ids = realloc(set->ids, r * sizeof(*set->ids));
+		AN(set->ids);
+		set->flags = realloc(set->flags, r * sizeof(*set->flags));
+		AN(set->flags);
+		set->reserved = r;
+	}
+	uint32_t i = set->n++;
+	set->ids[i] = id;
+	set->flags[i] = flags;
+	set->index[id] = i;
+}
+
+void lvl_tag_sector_dirty(struct lvl* lvl, int32_t sectori)
+{
+	idset_put(&lvl->tags.dirty_sectors, sectori, 1);
+}
+
+void lvl_tag_sidedef_dirty(struct lvl* lvl, int32_t sidedefi)
+{
+	idset_put(&lvl->tags.dirty_sidedefs, sidedefi, 1);
+}
+
+void lvl_tag_clear_dirty(struct lvl* lvl)
+{
+	lvl->tags.dirty_sectors.n = 0;
+	lvl->tags.dirty_sidedefs.n = 0;
+}
+
+#define TAG_MASK (LVL_HIGHLIGHTED | LVL_SELECTED)
+
+static void set_sector_tags(struct lvl* lvl, int32_t sectori, uint32_t tags)
+{
+	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
+	if ((sector->usr & TAG_MASK) == tags) return;
+	sector->usr = (sector->usr & ~TAG_MASK) | tags;
+	idset_put(&lvl->tags.sectors, sectori, tags);
+	lvl_tag_sector_dirty(lvl, sectori);
+}
+
+static void set_sidedef_tags(struct lvl* lvl, int32_t sidedefi, uint32_t tags)
+{
+	struct lvl_sidedef* sd = lvl_get_sidedef(lvl, sidedefi);
+	if ((sd->usr & TAG_MASK) == tags) return;
+	sd->usr = (sd->usr & ~TAG_MASK) | tags;
+	idset_put(&lvl->tags.sidedefs, sidedefi, tags);
+	lvl_tag_sidedef_dirty(lvl, sidedefi);
+}
+
+/* walks the sets backwards, since members dropping out of them swap in the
+ * last one */
+static void lvl_tag_apply_mask(struct lvl* lvl, uint32_t mask)
+{
+	struct lvl_idset* sectors = &lvl->tags.sectors;
+	for (int i = (int)sectors->n - 1; i >= 0; i--) {
+		set_sector_tags(lvl, sectors->ids[i], sectors->flags[i] & mask);
+	}
+	struct lvl_idset* sidedefs = &lvl->tags.sidedefs;
+	for (int i = (int)sidedefs->n - 1; i >= 0; i--) {
+		set_sidedef_tags(lvl, sidedefs->ids[i], sidedefs->flags[i] & mask);
 	}
 }
 
 void lvl_tag_clear_highlights(struct lvl* lvl)
 {
-	lvl_tag_apply_mask(lvl, ~(LVL_HIGHLIGHTED_ZPLUS | LVL_HIGHLIGHTED_ZMINUS));
+	lvl_tag_apply_mask(lvl, ~LVL_HIGHLIGHTED);
 }
 
 void lvl_tag_clear_all(struct lvl* lvl)
 {
-	lvl_tag_apply_mask(lvl, ~(LVL_HIGHLIGHTED_ZPLUS | LVL_HIGHLIGHTED_ZMINUS | LVL_SELECTED_ZMINUS | LVL_SELECTED_ZPLUS));
+	lvl_tag_apply_mask(lvl, ~(LVL_HIGHLIGHTED | LVL_SELECTED));
 }
 
 void lvl_tag_flats(struct lvl* lvl, struct lvl_trace_result* trace, int clicked)
 {
-	for (int i = 0; i < lvl->n_sectors; i++) {
-		struct lvl_sector* sector = lvl_get_sector(lvl, i);
+	struct lvl_idset* sectors = &lvl->tags.sectors;
+	for (int i = (int)sectors->n - 1; i >= 0; i--) {
+		set_sector_tags(lvl, sectors->ids[i], sectors->flags[i] & ~LVL_HIGHLIGHTED);
+	}
 
-		sector->usr &= ~(LVL_HIGHLIGHTED_ZMINUS | LVL_HIGHLIGHTED_ZPLUS);
-		if (i == trace->sector && trace->linedef == -1) {
-			if (trace->z > 0) {
-				sector->usr |= LVL_HIGHLIGHTED_ZPLUS;
-				if (clicked) {
-					sector->usr ^= LVL_SELECTED_ZPLUS;
-				}
-			}
+	if (trace->sector == -1 || trace->linedef != -1) return;
 
-			if (trace->z < 0) {
-				sector->usr |= LVL_HIGHLIGHTED_ZMINUS;
-				if (clicked) {
-					sector->usr ^= LVL_SELECTED_ZMINUS;
-				}
-			}
+	uint32_t tags = lvl_get_sector(lvl, trace->sector)->usr & TAG_MASK;
+	if (trace->z > 0) {
+		tags |= LVL_HIGHLIGHTED_ZPLUS;
+		if (clicked) {
+			tags ^= LVL_SELECTED_ZPLUS;
 		}
 	}
+
+	if (trace->z < 0) {
+		tags |= LVL_HIGHLIGHTED_ZMINUS;
+		if (clicked) {
+			tags ^= LVL_SELECTED_ZMINUS;
+		}
+	}
+	set_sector_tags(lvl, trace->sector, tags);
 }
 
 void lvl_tag_sectors(struct lvl* lvl, struct lvl_trace_result* trace, int clicked)
 {
-	int selected = LVL_SELECTED_ZPLUS | LVL_SELECTED_ZMINUS;
-	int highlighted = LVL_HIGHLIGHTED_ZPLUS | LVL_HIGHLIGHTED_ZMINUS;
-
-	for (int i = 0; i < lvl->n_sectors; i++) {
-		struct lvl_sector* sector = lvl_get_sector(lvl, i);
-
-		if (i == trace->sector) {
-			sector->usr |= highlighted;
-			if (clicked) {
-				sector->usr ^= selected;
-			}
-		} else {
-			sector->usr &= ~highlighted;
-		}
+	lvl_tag_clear_highlights(lvl);
 
-		for (int j = 0; j < sector->contourn; j++) {
-			int32_t ci = sector->contour0 + j;
-			struct lvl_contour* c = lvl_get_contour(lvl, ci);
-			struct lvl_linedef* ld = lvl_get_linedef(lvl, c->linedef);
-			uint32_t sdi = ld->sidedef[c->usr&1];
-			ASSERT(sdi != -1);
+	if (trace->sector == -1) return;
 
-			struct lvl_sidedef* sd = lvl_get_sidedef(lvl, sdi);
+	uint32_t tags = lvl_get_sector(lvl, trace->sector)->usr & TAG_MASK;
+	tags |= LVL_HIGHLIGHTED;
+	if (clicked) {
+		tags ^= LVL_SELECTED;
+	}
+	set_sector_tags(lvl, trace->sector, tags);
 
-			if (i == trace->sector) {
-				sd->usr |= highlighted;
-				if (clicked) {
-					sd->usr ^= selected;
-				}
-			} else {
-				sd->usr &= ~highlighted;
-			}
+	struct lvl_sector* sector = lvl_get_sector(lvl, trace->sector);
+	for (int j = 0; j < sector->contourn; j++) {
+		int32_t ci = sector->contour0 + j;
+		struct lvl_contour* c = lvl_get_contour(lvl, ci);
+		struct lvl_linedef* ld = lvl_get_linedef(lvl, c->linedef);
+		uint32_t sdi = ld->sidedef[c->usr&1];
+		ASSERT(sdi != -1);
+
+		uint32_t sdtags = lvl_get_sidedef(lvl, sdi)->usr & TAG_MASK;
+		sdtags |= LVL_HIGHLIGHTED;
+		if (clicked) {
+			sdtags ^= LVL_SELECTED;
 		}
+		set_sidedef_tags(lvl, sdi, sdtags);
 	}
 }
 
 void lvl_tag_sidedefs(struct lvl* lvl, struct lvl_trace_result* trace, int clicked)
 {
-	for (int i = 0; i < lvl->n_sectors; i++) {
-		struct lvl_sector* sector = lvl_get_sector(lvl, i);
-
-		for (int j = 0; j < sector->contourn; j++) {
-			int32_t ci = sector->contour0 + j;
-			struct lvl_contour* c = lvl_get_contour(lvl, ci);
-			struct lvl_linedef* ld = lvl_get_linedef(lvl, c->linedef);
-			uint32_t sdi = ld->sidedef[c->usr&1];
-			ASSERT(sdi != -1);
-
-			struct lvl_sidedef* sd = lvl_get_sidedef(lvl, sdi);
+	struct lvl_idset* sidedefs = &lvl->tags.sidedefs;
+	for (int i = (int)sidedefs->n - 1; i >= 0; i--) {
+		set_sidedef_tags(lvl, sidedefs->ids[i], sidedefs->flags[i] & ~LVL_HIGHLIGHTED);
+	}
 
-			sd->usr &= ~(LVL_HIGHLIGHTED_ZMINUS | LVL_HIGHLIGHTED_ZPLUS);
+	if (trace->sidedef == -1) return;
 
-			if (trace->sidedef == sdi) {
-				if (trace->z >= 0) {
-					sd->usr |= LVL_HIGHLIGHTED_ZPLUS;
-					if (clicked) {
-						sd->usr ^= LVL_SELECTED_ZPLUS;
-					}
-				}
+	uint32_t tags = lvl_get_sidedef(lvl, trace->sidedef)->usr & TAG_MASK;
+	if (trace->z >= 0) {
+		tags |= LVL_HIGHLIGHTED_ZPLUS;
+		if (clicked) {
+			tags ^= LVL_SELECTED_ZPLUS;
+		}
+	}
 
-				if (trace->z <= 0) {
-					sd->usr |= LVL_HIGHLIGHTED_ZMINUS;
-					if (clicked) {
-						sd->usr ^= LVL_SELECTED_ZMINUS;
-					}
-				}
-			}
+	if (trace->z <= 0) {
+		tags |= LVL_HIGHLIGHTED_ZMINUS;
+		if (clicked) {
+			tags ^= LVL_SELECTED_ZMINUS;
 		}
 	}
+	set_sidedef_tags(lvl, trace->sidedef, tags);
 }
@@ -1,6 +1,7 @@
 #ifndef LVL_H
 #define LVL_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "m.h"
 
@@ -9,6 +10,9 @@
 #define LVL_HIGHLIGHTED_ZMINUS (1<<2)
 #define LVL_SELECTED_ZMINUS (1<<3)
 
+#define LVL_HIGHLIGHTED (LVL_HIGHLIGHTED_ZPLUS | LVL_HIGHLIGHTED_ZMINUS)
+#define LVL_SELECTED (LVL_SELECTED_ZPLUS | LVL_SELECTED_ZMINUS)
+
 #define LVL_CONTOUR_IS_FIRST(c) (c->usr & 2)
 #define LVL_CONTOUR_IS_LAST(c) (c->usr & 4)
 
@@ -47,6 +51,27 @@ struct lvl_contour {
 
 #define ENTITY_DELETED (-1)
 
+#define ENTITY_CLIPS (1<<0) // pushed out of walls and low openings
+
+enum lvl_entity_draw {
+	ENTITY_DRAW_NONE = 0,
+	ENTITY_DRAW_SPRITE,
+	ENTITY_DRAW_MESH
+};
+
+/* what's the same for all entities of a type; from entities.inc.h, indexed
+ * by type id */
+struct lvl_entity_type {
+	float radius;
+	float height;
+	uint8_t draw;
+	uint8_t flags;
+	uint16_t think;
+	int32_t art;
+};
+
+extern const struct lvl_entity_type lvl_entity_types[];
+
 struct lvl_entity {
 	int32_t type;
 	struct vec2 position;
@@ -55,6 +80,34 @@ struct lvl_entity {
 	float yaw;
 	float pitch;
 	int32_t sector;
+
+	// state at the start of the current tick (see lvl_entity_lerp())
+	struct vec2 prev_position;
+	float prev_z;
+	float prev_yaw;
+	float prev_pitch;
+};
+
+/* sparse set of sector or sidedef indices, each with some flags. insert,
+ * remove and lookup are O(1), clearing and iterating are O(members) */
+struct lvl_idset {
+	uint32_t n, reserved;
+	int32_t* ids;
+	uint32_t* flags; // parallel to ids
+
+	uint32_t reserved_index;
+	uint32_t* index; // id -> position in ids (only valid for members)
+};
+
+/* the editor's tags. the HIGHLIGHTED/SELECTED bits in sector and sidedef
+ * usr are mirrored in the sets, so nothing has to scan the level to find
+ * them. "dirty" collects elements whose tags or properties changed since
+ * the last lvl_tag_clear_dirty(); render caches feed on it */
+struct lvl_tags {
+	struct lvl_idset sectors;
+	struct lvl_idset sidedefs;
+	struct lvl_idset dirty_sectors;
+	struct lvl_idset dirty_sidedefs;
 };
 
 struct lvl {
@@ -75,9 +128,25 @@ struct lvl {
 
 	uint32_t n_entities, reserved_entities;
 	struct lvl_entity* entities;
+
+	// plan builds are deterministic given plan+seed (see llvl_build())
+	uint32_t seed;
+
+	/* different for every level set up (see lvl_next_generation()), so
+	 * caches can tell levels apart; addresses get reused */
+	uint32_t generation;
+
+	struct lvl_tags tags;
+
+	// set when the arrays point into a compiled level (see lvlb.h)
+	void* _mapping;
+	size_t _mapping_sz;
 };
 
 void lvl_init(struct lvl*);
+// for code that sets up a struct lvl without lvl_init() (e.g. lvlb_load())
+uint32_t lvl_next_generation(void);
+void lvl_free(struct lvl*);
 
 uint32_t lvl_new_entity(struct lvl*);
 struct lvl_entity* lvl_get_entity(struct lvl*, int32_t i);
@@ -103,8 +172,22 @@ void lvl_entity_update_sector(struct lvl* lvl, struct lvl_entity* entity);
 void lvl_entity_accelerate(struct lvl* lvl, struct lvl_entity* entity, struct vec2* acceleration, float dt);
 void lvl_entity_clipmove(struct lvl* lvl, struct lvl_entity* entity, float dt);
 
+/* call before every simulation tick; rendering interpolates between the
+ * state saved here and the state after the tick */
+void lvl_entity_begin_tick(struct lvl_entity* entity);
+void lvl_begin_tick(struct lvl* lvl);
+
+// dst is src as of alpha (0..1) into its current tick
+void lvl_entity_lerp(struct lvl_entity* dst, struct lvl_entity* src, float alpha);
+
 void lvl_build_contours(struct lvl* lvl);
 
+// not for ENTITY_DELETED ones
+static inline const struct lvl_entity_type* lvl_entity_type(struct lvl_entity* entity)
+{
+	return &lvl_entity_types[entity->type];
+}
+
 float lvl_entity_radius(struct lvl_entity* entity);
 
 void lvl_entity_view_plane(struct lvl_entity* entity, struct vec3* pos, struct vec3* dir, struct vec3* right, struct vec3* up);
@@ -134,4 +217,12 @@ void lvl_tag_flats(struct lvl* lvl, struct lvl_trace_result* trace, int clicked)
 void lvl_tag_sectors(struct lvl* lvl, struct lvl_trace_result* trace, int clicked);
 void lvl_tag_sidedefs(struct lvl* lvl, struct lvl_trace_result* trace, int clicked);
 
+// call after editing a sector's or sidedef's properties
+void lvl_tag_sector_dirty(struct lvl* lvl, int32_t sectori);
+void lvl_tag_sidedef_dirty(struct lvl* lvl, int32_t sidedefi);
+void lvl_tag_clear_dirty(struct lvl* lvl);
+
+int lvl_idset_has(struct lvl_idset* set, int32_t id);
+uint32_t lvl_idset_get(struct lvl_idset* set, int32_t id); // 0 if not a member
+
 #endif//LVL_H
@@ -0,0 +1,170 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "lvlb.h"
+#include "a.h"
+#include "prof.h"
+
+#define LVLB_N_ARRAYS (6)
+#define LVLB_ALIGN (16)
+
+struct lvlb_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t checksum; // of everything following the header
+	uint32_t seed;
+	uint32_t _pad;
+	uint32_t n[LVLB_N_ARRAYS];
+	uint32_t elem_sz[LVLB_N_ARRAYS];
+	uint64_t offset[LVLB_N_ARRAYS];
+	uint64_t size;
+};
+
+struct lvlb_array {
+	uint32_t* n;
+	uint32_t* reserved;
+	void** data;
+	size_t elem_sz;
+};
+
+static void lvlb_arrays(struct lvl* lvl, struct lvlb_array* arrays)
+{
+	int i = 0;
+	#define ARRAY(name, type) \
+		arrays[i].n = &lvl->n_##name; \
+		arrays[i].reserved = &lvl->reserved_##name; \
+		arrays[i].data = (void**)&lvl->name; \
+		arrays[i].elem_sz = sizeof(type); \
+		i++;
+	ARRAY(sectors, struct lvl_sector)
+	ARRAY(linedefs, struct lvl_linedef)
+	ARRAY(sidedefs, struct lvl_sidedef)
+	ARRAY(vertices, struct vec2)
+	ARRAY(contours, struct lvl_contour)
+	ARRAY(entities, struct lvl_entity)
+	#undef ARRAY
+	ASSERT(i == LVLB_N_ARRAYS);
+}
+
+uint64_t lvlb_hash(uint64_t hash, const void* data, size_t n)
+{
+	if (hash == 0) hash = 0xcbf29ce484222325ULL;
+	const uint8_t* p = data;
+	for (size_t i = 0; i < n; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static size_t align(size_t x)
+{
+	return (x + (LVLB_ALIGN-1)) & ~(size_t)(LVLB_ALIGN-1);
+}
+
+void lvlb_save(const char* path, struct lvl* lvl)
+{
+	struct lvlb_array arrays[LVLB_N_ARRAYS];
+	lvlb_arrays(lvl, arrays);
+
+	struct lvlb_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = LVLB_MAGIC;
+	header.version = LVLB_VERSION;
+	header.seed = lvl->seed;
+
+	size_t offset = align(sizeof(header));
+	for (int i = 0; i < LVLB_N_ARRAYS; i++) {
+		header.n[i] = *arrays[i].n;
+		header.elem_sz[i] = arrays[i].elem_sz;
+		header.offset[i] = offset;
+		offset = align(offset + header.n[i] * arrays[i].elem_sz);
+	}
+	header.size = offset;
+
+	uint8_t* data = calloc(1, header.size);
+	AN(data);
+	for (int i = 0; i < LVLB_N_ARRAYS; i++) {
+		memcpy(data + header.offset[i], *arrays[i].data, header.n[i] * arrays[i].elem_sz);
+	}
+	size_t payload = header.size - sizeof(header);
+	header.checksum = lvlb_hash(0, data + sizeof(header), payload);
+	memcpy(data, &header, sizeof(header));
+
+	/* write to a temporary and rename so a concurrent lvlb_load() never
+	 * sees a partially written file */
+	char tmp[1024];
+	ASSERT(strlen(path) + 5 < sizeof(tmp));
+	sprintf(tmp, "%s.tmp", path);
+
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL) arghf("%s: %s", tmp, strerror(errno));
+	if (fwrite(data, header.size, 1, f) != 1) arghf("%s: write failed", tmp);
+	if (fclose(f) != 0) arghf("%s: %s", tmp, strerror(errno));
+	if (rename(tmp, path) == -1) arghf("rename(%s, %s): %s", tmp, path, strerror(errno));
+
+	free(data);
+}
+
+int lvlb_load(const char* path, struct lvl* lvl)
+{
+	PROF_ZONE("lvlb_load");
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < sizeof(struct lvlb_header)) {
+		close(fd);
+		return -1;
+	}
+
+	// private+writable; the level is mutated at runtime (entities, editing)
+	void* mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return -1;
+
+	struct lvlb_header* header = mapping;
+
+	memset(lvl, 0, sizeof(struct lvl));
+	lvl->generation = lvl_next_generation();
+	struct lvlb_array arrays[LVLB_N_ARRAYS];
+	lvlb_arrays(lvl, arrays);
+
+	int valid =
+		header->magic == LVLB_MAGIC &&
+		header->version == LVLB_VERSION &&
+		header->size == st.st_size;
+	for (int i = 0; valid && i < LVLB_N_ARRAYS; i++) {
+		if (header->elem_sz[i] != arrays[i].elem_sz) valid = 0;
+		if (header->offset[i] % LVLB_ALIGN != 0) valid = 0;
+		if (header->offset[i] + (uint64_t)header->n[i] * arrays[i].elem_sz > header->size) valid = 0;
+	}
+	if (valid) {
+		uint8_t* p = mapping;
+		uint64_t checksum = lvlb_hash(0, p + sizeof(*header), header->size - sizeof(*header));
+		if (checksum != header->checksum) valid = 0;
+	}
+	if (!valid) {
+		munmap(mapping, st.st_size);
+		return -1;
+	}
+
+	for (int i = 0; i < LVLB_N_ARRAYS; i++) {
+		*arrays[i].n = *arrays[i].reserved = header->n[i];
+		*arrays[i].data = (uint8_t*)mapping + header->offset[i];
+	}
+
+	lvl->seed = header->seed;
+	lvl->_mapping = mapping;
+	lvl->_mapping_sz = st.st_size;
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef LVLB_H
+#define LVLB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lvl.h"
+
+/* compiled levels. the flat lvl arrays (including the derived contours) are
+ * dumped as-is after a small header; lvlb_load() mmaps the file and points
+ * the lvl arrays straight into the mapping, so loading is (nearly) free.
+ * the format is native endian and tied to the struct layouts in lvl.h;
+ * author levels in Lua and compile them with lvlbc */
+
+#define LVLB_MAGIC (0x424c564c) // "LVLB"
+#define LVLB_VERSION (3)
+
+// writes a compiled level; arghf()s on errors
+void lvlb_save(const char* path, struct lvl* lvl);
+
+/* initializes lvl (don't call lvl_init() first) from a compiled level.
+ * returns 0 on success, or -1 if the file is missing, damaged or was written
+ * by an incompatible build */
+int lvlb_load(const char* path, struct lvl* lvl);
+
+// FNV-1a; start with hash=0
+uint64_t lvlb_hash(uint64_t hash, const void* data, size_t n);
+
+#endif/*LVLB_H*/
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lvl.h"
+#include "llvl.h"
+#include "lvlb.h"
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-s <seed>] (-p <plan> | -b <brickname>) <out.lvlb>\n", argv0);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+
+	int argi = 1;
+	if (argi+1 < argc && strcmp(argv[argi], "-s") == 0) {
+		seed = strtoul(argv[argi+1], NULL, 10);
+		argi += 2;
+	}
+	if (argc - argi != 3 || (strcmp(argv[argi], "-p") != 0 && strcmp(argv[argi], "-b") != 0)) {
+		usage(argv[0]);
+	}
+
+	struct lvl lvl;
+	lvl_init(&lvl);
+
+	if (strcmp(argv[argi], "-p") == 0) {
+		llvl_build(argv[argi+1], seed, &lvl);
+	} else {
+		llvl_load(argv[argi+1], &lvl);
+	}
+
+	lvlb_save(argv[argi+2], &lvl);
+
+	return EXIT_SUCCESS;
+}
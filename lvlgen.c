@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen.h"
+#include "lvl.h"
+#include "lvlb.h"
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-s <seed>] [-l <layout>] [-n <cells>] [-p <every>] [-P <vertices>] [-e <entities>] <out.lvlb>\n", argv0);
+	fprintf(stderr, "  -s    seed (default 1)\n");
+	fprintf(stderr, "  -l    grid, maze or spiral (default grid)\n");
+	fprintf(stderr, "  -n    number of cell sectors (default 1000)\n");
+	fprintf(stderr, "  -p    put a pillar (hole) in every nth cell\n");
+	fprintf(stderr, "  -P    add a star sector with this many vertices\n");
+	fprintf(stderr, "  -e    number of entities\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	struct gen_params params;
+	gen_params_init(&params);
+
+	int argi = 1;
+	for (; argi < argc && argv[argi][0] == '-'; argi++) {
+		if (argi+1 >= argc) usage(argv[0]);
+		char* arg = argv[++argi];
+		switch (argv[argi-1][1]) {
+		case 's': params.seed = strtoul(arg, NULL, 10); break;
+		case 'l': {
+			int layout = gen_find_layout(arg);
+			if (layout == -1) usage(argv[0]);
+			params.layout = layout;
+			} break;
+		case 'n': params.n_cells = atoi(arg); break;
+		case 'p': params.pillar_every = atoi(arg); break;
+		case 'P': params.polygon_vertices = atoi(arg); break;
+		case 'e': params.n_entities = atoi(arg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (argi != argc-1 || params.n_cells <= 0) usage(argv[0]);
+
+	struct lvl lvl;
+	lvl_init(&lvl);
+	gen_level(&params, &lvl);
+
+	printf("%s: %u sectors, %u linedefs, %u contours, %u entities\n",
+		argv[argi], lvl.n_sectors, lvl.n_linedefs, lvl.n_contours, lvl.n_entities);
+
+	lvlb_save(argv[argi], &lvl);
+	lvl_free(&lvl);
+
+	return EXIT_SUCCESS;
+}
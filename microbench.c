@@ -0,0 +1,387 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "a.h"
+#include "lvl.h"
+#include "llvl.h"
+#include "plan.h"
+#include "gen.h"
+#include "flat.h"
+#include "mud.h"
+#include "tick.h"
+
+/* micro-benchmarks of the level geometry hot paths. every input is either
+ * a shipped brick or plan, or a synthetic level chained together from
+ * bricks with a fixed seed, and the probes (points, rays, entities) are
+ * drawn from a fixed seed too, so runs are comparable over time.
+ *
+ * each benchmark runs a batch of operations per iteration; after some
+ * warmup iterations the per operation time of every iteration is sampled.
+ * results go to stdout as CSV, one line per benchmark and input */
+
+#define WARMUP_ITERATIONS (3)
+#define N_PROBES (256)
+#define N_ENTITIES (64)
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-i <iterations>] [-f <filter>]\n", argv0);
+	fprintf(stderr, "  -i    sampled iterations per benchmark (default 50)\n");
+	fprintf(stderr, "  -f    only run benchmarks whose name contains <filter>\n");
+	exit(EXIT_FAILURE);
+}
+
+// Park-Miller, like the plan builder
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+	rng_state = (uint64_t)rng_state * 16807 % 2147483647;
+	return rng_state;
+}
+
+static float rng_float(float lo, float hi)
+{
+	return lo + (hi - lo) * ((float)(rng_next() % 1000000) / 1000000.0f);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	AZ(clock_gettime(CLOCK_MONOTONIC, &ts));
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* inputs */
+
+enum input_kind {
+	INPUT_BRICK = 0,
+	INPUT_PLAN,
+	INPUT_SYNTHETIC,
+	INPUT_GENERATED
+};
+
+struct input {
+	enum input_kind kind;
+	const char* name;
+	int n; // bricks for INPUT_SYNTHETIC, cells for INPUT_GENERATED
+};
+
+static struct input inputs[] = {
+	{INPUT_BRICK, "begin", 0},
+	{INPUT_BRICK, "end", 0},
+	{INPUT_BRICK, "x0", 0},
+	{INPUT_BRICK, "x1", 0},
+	{INPUT_BRICK, "x2", 0},
+	{INPUT_BRICK, "x3", 0},
+	{INPUT_BRICK, "y0", 0},
+	{INPUT_BRICK, "y1", 0},
+	{INPUT_PLAN, "l0", 0},
+	{INPUT_PLAN, "l1", 0},
+	{INPUT_SYNTHETIC, "x1", 64},
+	{INPUT_SYNTHETIC, "x1", 512},
+	{INPUT_GENERATED, "grid", 1000},
+	{INPUT_GENERATED, "maze", 1000},
+	{INPUT_GENERATED, "spiral", 1000},
+};
+
+static const char* pngs[] = {
+	"gfx/flat0.png",
+	"gfx/flat1.png",
+	"gfx/wall0.png",
+	"gfx/wall1.png",
+};
+
+#define N_INPUTS (sizeof(inputs) / sizeof(inputs[0]))
+#define N_PNGS (sizeof(pngs) / sizeof(pngs[0]))
+
+static void load_input(struct input* input, struct lvl* lvl, char* label, size_t label_sz)
+{
+	lvl_init(lvl);
+	switch (input->kind) {
+	case INPUT_BRICK:
+		llvl_load(input->name, lvl);
+		snprintf(label, label_sz, "brick:%s", input->name);
+		break;
+	case INPUT_PLAN:
+		llvl_build(input->name, 1, lvl);
+		snprintf(label, label_sz, "plan:%s", input->name);
+		break;
+	case INPUT_SYNTHETIC: {
+		struct plan plan;
+		plan_init(&plan, 1);
+		for (int i = 0; i < input->n; i++) {
+			plan_insert_brick(&plan, lvl, input->name);
+		}
+		plan_free(&plan);
+		lvl_build_contours(lvl);
+		snprintf(label, label_sz, "%s*%d", input->name, input->n);
+		} break;
+	case INPUT_GENERATED: {
+		// (the stress levels' extras, see the Makefile)
+		struct gen_params params;
+		gen_params_init(&params);
+		params.layout = gen_find_layout(input->name);
+		params.n_cells = input->n;
+		params.pillar_every = 7;
+		params.polygon_vertices = 1024;
+		gen_level(&params, lvl);
+		snprintf(label, label_sz, "gen:%s-%d", input->name, input->n);
+		} break;
+	}
+}
+
+/* probes; (re)drawn for every input */
+
+static struct lvl* lvl;
+
+static struct vec2 points[N_PROBES];
+
+static struct {
+	int32_t sector;
+	struct vec3 origin;
+	struct vec3 ray;
+} rays[N_PROBES];
+
+static struct lvl_entity entities[N_ENTITIES];
+static struct lvl_entity moved[N_ENTITIES];
+
+static struct flat_tess ft;
+
+static void bounds(struct vec2* min, struct vec2* max)
+{
+	for (int i = 0; i < lvl->n_vertices; i++) {
+		struct vec2* v = lvl_get_vertex(lvl, i);
+		for (int j = 0; j < 2; j++) {
+			if (i == 0 || v->s[j] < min->s[j]) min->s[j] = v->s[j];
+			if (i == 0 || v->s[j] > max->s[j]) max->s[j] = v->s[j];
+		}
+	}
+}
+
+// a random point inside the level
+static int32_t inside(struct vec2* min, struct vec2* max, struct vec2* p)
+{
+	int tries = 0;
+	int32_t sector;
+	do {
+		if (++tries > 10000) arghf("could not find a point inside the level");
+		p->s[0] = rng_float(min->s[0], max->s[0]);
+		p->s[1] = rng_float(min->s[1], max->s[1]);
+	} while ((sector = lvl_sector_find(lvl, p)) == -1);
+	return sector;
+}
+
+static void prepare(void)
+{
+	rng_state = 1;
+
+	struct vec2 min, max;
+	bounds(&min, &max);
+
+	// (a mix of hits and misses, like picking)
+	for (int i = 0; i < N_PROBES; i++) {
+		points[i].s[0] = rng_float(min.s[0], max.s[0]);
+		points[i].s[1] = rng_float(min.s[1], max.s[1]);
+	}
+
+	for (int i = 0; i < N_PROBES; i++) {
+		struct vec2 p;
+		int32_t sector = inside(&min, &max, &p);
+		struct lvl_sector* s = lvl_get_sector(lvl, sector);
+		rays[i].sector = sector;
+		rays[i].origin.s[0] = p.s[0];
+		rays[i].origin.s[1] = p.s[1];
+		rays[i].origin.s[2] = rng_float(s->flat[0].z, s->flat[1].z);
+		struct vec2 d;
+		vec2_angle(&d, rng_float(0, 360));
+		rays[i].ray.s[0] = d.s[0];
+		rays[i].ray.s[1] = d.s[1];
+		rays[i].ray.s[2] = rng_float(-0.5f, 0.5f);
+	}
+
+	for (int i = 0; i < N_ENTITIES; i++) {
+		struct lvl_entity* e = &entities[i];
+		memset(e, 0, sizeof(*e));
+		inside(&min, &max, &e->position);
+		e->yaw = rng_float(0, 360);
+		vec2_angle(&e->velocity, e->yaw);
+		vec2_scalei(&e->velocity, rng_float(0, 400));
+		lvl_entity_update_sector(lvl, e);
+	}
+}
+
+/* benchmarks; each runs one batch and returns the number of operations */
+
+// (keeps results from being optimized away)
+static volatile int32_t sink;
+
+static int bench_sector_find(void)
+{
+	int32_t sum = 0;
+	for (int i = 0; i < N_PROBES; i++) sum += lvl_sector_find(lvl, &points[i]);
+	sink = sum;
+	return N_PROBES;
+}
+
+static int bench_trace(void)
+{
+	struct lvl_trace_result result;
+	for (int i = 0; i < N_PROBES; i++) {
+		lvl_trace(lvl, rays[i].sector, &rays[i].origin, &rays[i].ray, &result);
+	}
+	return N_PROBES;
+}
+
+static int bench_clipmove(void)
+{
+	memcpy(moved, entities, sizeof(moved));
+	for (int i = 0; i < N_ENTITIES; i++) lvl_entity_clipmove(lvl, &moved[i], TICK_DT);
+	return N_ENTITIES;
+}
+
+static int bench_build_contours(void)
+{
+	lvl_build_contours(lvl);
+	return 1;
+}
+
+static int tess_all(void)
+{
+	struct flat_mesh mesh;
+	for (int i = 0; i < lvl->n_sectors; i++) {
+		flat_tess_sector(&ft, lvl, i, &mesh);
+		flat_tess_end(&ft);
+	}
+	return lvl->n_sectors;
+}
+
+static int bench_flat_tess(void)
+{
+	ft.sweep_only = 0;
+	return tess_all();
+}
+
+static int bench_flat_tess_sweep(void)
+{
+	ft.sweep_only = 1;
+	return tess_all();
+}
+
+static int bench_png(void)
+{
+	for (int i = 0; i < N_PNGS; i++) {
+		uint8_t* data;
+		int width, height;
+		AZ(mud_load_png_paletted(pngs[i], &data, &width, &height));
+		free(data);
+	}
+	return N_PNGS;
+}
+
+struct bench {
+	const char* name;
+	int (*run)(void);
+};
+
+static struct bench lvl_benches[] = {
+	{"sector_find", bench_sector_find},
+	{"trace", bench_trace},
+	{"clipmove", bench_clipmove},
+	{"build_contours", bench_build_contours},
+	{"flat_tess", bench_flat_tess},
+	{"flat_tess_sweep", bench_flat_tess_sweep},
+};
+
+#define N_LVL_BENCHES (sizeof(lvl_benches) / sizeof(lvl_benches[0]))
+
+/* sampling */
+
+static int n_iterations = 50;
+static char* filter = NULL;
+static double* samples;
+
+static int double_compare(const void* va, const void* vb)
+{
+	double a = *(const double*)va;
+	double b = *(const double*)vb;
+	return (a > b) - (a < b);
+}
+
+static void run(struct bench* bench, const char* input)
+{
+	if (filter != NULL && strstr(bench->name, filter) == NULL) return;
+
+	for (int i = 0; i < WARMUP_ITERATIONS; i++) bench->run();
+
+	int ops = 0;
+	for (int i = 0; i < n_iterations; i++) {
+		double t0 = now();
+		ops = bench->run();
+		double t1 = now();
+		samples[i] = ops > 0 ? (t1 - t0) / (double)ops : 0.0;
+	}
+
+	qsort(samples, n_iterations, sizeof(double), double_compare);
+
+	double mean = 0;
+	for (int i = 0; i < n_iterations; i++) mean += samples[i];
+	mean /= (double)n_iterations;
+
+	int p99 = (n_iterations * 99 + 99) / 100 - 1;
+
+	printf("%s,%s,%d,%d,%.1f,%.1f,%.1f,%.1f\n",
+		bench->name,
+		input,
+		ops,
+		n_iterations,
+		samples[n_iterations / 2],
+		samples[p99],
+		samples[0],
+		mean);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	for (int argi = 1; argi < argc; argi++) {
+		if (strcmp(argv[argi], "-i") == 0 && argi+1 < argc) {
+			n_iterations = atoi(argv[++argi]);
+		} else if (strcmp(argv[argi], "-f") == 0 && argi+1 < argc) {
+			filter = argv[++argi];
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (n_iterations <= 0) usage(argv[0]);
+
+	samples = malloc(n_iterations * sizeof(double));
+	AN(samples);
+
+	flat_tess_init(&ft);
+
+	// times are in nanoseconds per operation
+	printf("bench,input,ops_per_iteration,iterations,median_ns,p99_ns,min_ns,mean_ns\n");
+
+	for (int i = 0; i < N_INPUTS; i++) {
+		static char label[64];
+		struct lvl input_lvl;
+		load_input(&inputs[i], &input_lvl, label, sizeof(label));
+		lvl = &input_lvl;
+		prepare();
+		for (int j = 0; j < N_LVL_BENCHES; j++) run(&lvl_benches[j], label);
+		lvl_free(&input_lvl);
+	}
+
+	struct bench png = {"png_paletted", bench_png};
+	run(&png, "gfx");
+
+	flat_tess_free(&ft);
+	free(samples);
+
+	return EXIT_SUCCESS;
+}
@@ -1,16 +1,17 @@
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <stdio.h>
 
 #include <png.h>
 
 #include "mud.h"
 #include "a.h"
+#include "prof.h"
 
 int mud_open(const char* pathname)
 {
@@ -22,18 +23,31 @@ int mud_open(const char* pathname)
 	return fd;
 }
 
-void mud_readn(int fd, void* vbuf, size_t n)
+// -1 (with errno set, 0 at end of file) unless all n bytes were read
+static int readn(int fd, void* vbuf, size_t n)
 {
 	char* buf = (char*) vbuf;
 	while(n > 0) {
 		ssize_t n_read = read((int)fd, buf, n);
 		if(n_read == -1) {
 			if(errno == EINTR) continue;
-			arghf("read: %s", strerror(errno));
+			return -1;
+		}
+		if(n_read == 0) {
+			errno = 0;
+			return -1;
 		}
 		n -= n_read;
 		buf += n_read;
 	}
+	return 0;
+}
+
+void mud_readn(int fd, void* vbuf, size_t n)
+{
+	if (readn(fd, vbuf, n) == -1) {
+		arghf("read: %s", errno ? strerror(errno) : "unexpected end of file");
+	}
 }
 
 
@@ -45,160 +59,144 @@ void mud_close(int fd)
 	}
 }
 
+/* libpng errors (and warnings) longjmp back to the loader, which reports
+ * the file as bad. the error pointer is the path */
 static void user_error_fn(png_structp png_ptr, png_const_charp error_msg)
 {
-	arghf("libpng error - %s", error_msg);
+	fprintf(stderr, "%s: libpng error - %s\n", (const char*)png_get_error_ptr(png_ptr), error_msg);
+	png_longjmp(png_ptr, 1);
 }
 
 static void user_warning_fn(png_structp png_ptr, png_const_charp warning_msg)
 {
-	arghf("libpng warning (promoted to error) - %s", warning_msg);
+	fprintf(stderr, "%s: libpng warning (promoted to error) - %s\n", (const char*)png_get_error_ptr(png_ptr), warning_msg);
+	png_longjmp(png_ptr, 1);
 }
 
 static void user_read_data_fn(png_structp png_ptr, png_bytep dest, png_size_t length)
 {
 	int fd = *((int*) png_get_io_ptr(png_ptr));
-	mud_readn(fd, dest, length);
+	if (readn(fd, dest, length) == -1) {
+		png_error(png_ptr, errno ? strerror(errno) : "unexpected end of file");
+	}
 }
 
-struct png_common {
-	int fd;
-	png_structp png_ptr;
-	png_infop info_ptr;
-	int width;
-	int height;
-	int channels;
-	int bit_depth;
-	int color_type;
-	int rowbytes;
-};
-
-static void mud_load_png_common(const char* rel, int* widthp, int* heightp, struct png_common* pc)
+/* reads an 8 bit PNG of the given color type; only its size if data is
+ * NULL, and its 256 color palette into palette if that isn't NULL. returns
+ * -1 (and says why on stderr) if the file can't be read or isn't like that,
+ * so a half written file doesn't take a running game down */
+static int load_png(const char* path, int color_type, uint8_t** data, int* widthp, int* heightp, uint8_t* palette)
 {
-	pc->fd = mud_open(rel);
-
-	png_byte header[8];
-	mud_readn(pc->fd, header, 8);
-	if (png_sig_cmp(header, 0, 8) != 0) {
-		arghf("mud_load_png_rgba: %s is not a PNG\n", rel);
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
 	}
 
-	pc->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)0, user_error_fn, user_warning_fn);
-	if (pc->png_ptr == NULL) {
-		arghf("png_create_read_struct failed for '%s'", rel);
+	png_byte header[8];
+	if (readn(fd, header, 8) == -1 || png_sig_cmp(header, 0, 8) != 0) {
+		fprintf(stderr, "%s: not a PNG\n", path);
+		close(fd);
+		return -1;
 	}
 
-	pc->info_ptr = png_create_info_struct(pc->png_ptr);
-	if (pc->info_ptr == NULL) {
-		arghf("png_create_info_struct failed for '%s'", rel);
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)path, user_error_fn, user_warning_fn);
+	if (png_ptr == NULL) {
+		arghf("png_create_read_struct failed for '%s'", path);
 	}
 
-	png_set_sig_bytes(pc->png_ptr, 8);
-	png_set_read_fn(pc->png_ptr, &pc->fd, user_read_data_fn);
-	png_read_info(pc->png_ptr, pc->info_ptr);
-
-	pc->width = png_get_image_width(pc->png_ptr, pc->info_ptr);
-	pc->height = png_get_image_height(pc->png_ptr, pc->info_ptr);
-
-	if (widthp != NULL) *widthp = pc->width;
-	if (heightp != NULL) *heightp = pc->height;
-
-	pc->channels = png_get_channels(pc->png_ptr, pc->info_ptr);
-	pc->bit_depth = png_get_bit_depth(pc->png_ptr, pc->info_ptr);
-	pc->color_type = png_get_color_type(pc->png_ptr, pc->info_ptr);
-	pc->rowbytes = png_get_rowbytes(pc->png_ptr, pc->info_ptr);
-}
-
-int mud_load_png_palette(const char* path, uint8_t* palette)
-{
-	AN(palette);
-
-	struct png_common pc;
-	mud_load_png_common(path, NULL, NULL, &pc);
-
-	if (pc.bit_depth != 8) {
-		arghf("%s: bit depth != 8", path);
-	}
-
-	if (pc.channels != 1 || pc.color_type != PNG_COLOR_TYPE_PALETTE) {
-		arghf("%s: not paletted", path);
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (info_ptr == NULL) {
+		arghf("png_create_info_struct failed for '%s'", path);
 	}
 
-	png_color* pp;
-	int num_palette = 0;
-	png_get_PLTE(pc.png_ptr, pc.info_ptr, &pp, &num_palette);
-	if (num_palette != 256) {
-		arghf("%s: not a 256 palette file (got %d)", path, num_palette);
-	}
-	for (int i = 0; i < 256; i++) {
-		palette[i*3] = pp[i].red;
-		palette[i*3+1] = pp[i].green;
-		palette[i*3+2] = pp[i].blue;
+	// (volatile, since they're changed between setjmp() and a longjmp)
+	uint8_t* volatile pixels = NULL;
+	png_bytep* volatile row_pointers = NULL;
+	const char* volatile error = NULL;
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		if (error) fprintf(stderr, "%s: %s\n", path, error);
+		free(pixels);
+		free(row_pointers);
+		png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+		close(fd);
+		return -1;
 	}
 
-	// FIXME clean up?
-	mud_close(pc.fd);
+	png_set_sig_bytes(png_ptr, 8);
+	png_set_read_fn(png_ptr, &fd, user_read_data_fn);
+	png_read_info(png_ptr, info_ptr);
 
-	return 0;
-}
+	int width = png_get_image_width(png_ptr, info_ptr);
+	int height = png_get_image_height(png_ptr, info_ptr);
+	int channels = png_get_channels(png_ptr, info_ptr);
+	int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
 
-int mud_load_png_paletted(const char* path, uint8_t** data, int* widthp, int* heightp)
-{
-	struct png_common pc;
-	mud_load_png_common(path, widthp, heightp, &pc);
+	if (png_get_bit_depth(png_ptr, info_ptr) != 8) {
+		error = "bit depth != 8";
+		png_longjmp(png_ptr, 1);
+	}
 
-	if (pc.bit_depth != 8) {
-		arghf("%s: bit depth != 8", path);
+	int want_channels = color_type == PNG_COLOR_TYPE_RGB ? 3 : 1;
+	if (channels != want_channels || png_get_color_type(png_ptr, info_ptr) != color_type) {
+		error = color_type == PNG_COLOR_TYPE_RGB ? "not RGB" : "not paletted";
+		png_longjmp(png_ptr, 1);
 	}
 
-	if (pc.channels != 1 || pc.color_type != PNG_COLOR_TYPE_PALETTE) {
-		arghf("%s: not paletted", path);
+	if (palette != NULL) {
+		png_color* pp;
+		int num_palette = 0;
+		png_get_PLTE(png_ptr, info_ptr, &pp, &num_palette);
+		if (num_palette != 256) {
+			error = "not a 256 palette file";
+			png_longjmp(png_ptr, 1);
+		}
+		for (int i = 0; i < 256; i++) {
+			palette[i*3] = pp[i].red;
+			palette[i*3+1] = pp[i].green;
+			palette[i*3+2] = pp[i].blue;
+		}
 	}
 
 	if (data != NULL) {
-		*data = malloc(pc.width * pc.height);
-
-		png_bytep *row_pointers = (png_bytep*) malloc(pc.height * sizeof(png_bytep*));
-		for(int i = 0; i < pc.height; i++) {
-			row_pointers[i] = ((png_bytep) *data) + pc.rowbytes * i;
+		pixels = malloc(width * height * channels + 1);
+		AN(pixels);
+		row_pointers = malloc(height * sizeof(png_bytep));
+		AN(row_pointers);
+		for(int i = 0; i < height; i++) {
+			row_pointers[i] = ((png_bytep) pixels) + rowbytes * i;
 		}
-		png_read_image(pc.png_ptr, row_pointers);
+		png_read_image(png_ptr, row_pointers);
 		free(row_pointers);
+		*data = pixels;
 	}
 
-	// FIXME clean up?
-	mud_close(pc.fd);
+	if (widthp != NULL) *widthp = width;
+	if (heightp != NULL) *heightp = height;
+
+	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+	close(fd);
 
 	return 0;
 }
 
-int mud_load_png_rgb(const char* path, uint8_t** data, int* widthp, int* heightp)
+int mud_load_png_palette(const char* path, uint8_t* palette)
 {
-	struct png_common pc;
-	mud_load_png_common(path, widthp, heightp, &pc);
-
-	if (pc.bit_depth != 8) {
-		arghf("%s: bit depth != 8", path);
-	}
-
-	if (pc.channels != 3 || pc.color_type != PNG_COLOR_TYPE_RGB) {
-		arghf("%s: not RGB", path);
-	}
-
-	if(data != NULL) {
-		*data = malloc(pc.width * pc.height * 3);
-
-		png_bytep *row_pointers = (png_bytep*) malloc(pc.height * sizeof(png_bytep*));
-		for(int i = 0; i < pc.height; i++) {
-			row_pointers[i] = ((png_bytep) *data) + pc.rowbytes * i;
-		}
-		png_read_image(pc.png_ptr, row_pointers);
-		free(row_pointers);
-	}
+	PROF_ZONE("mud_load_png_palette");
+	AN(palette);
+	return load_png(path, PNG_COLOR_TYPE_PALETTE, NULL, NULL, NULL, palette);
+}
 
-	mud_close(pc.fd);
+int mud_load_png_paletted(const char* path, uint8_t** data, int* widthp, int* heightp)
+{
+	PROF_ZONE("mud_load_png_paletted");
+	return load_png(path, PNG_COLOR_TYPE_PALETTE, data, widthp, heightp, NULL);
+}
 
-	return 0;
+int mud_load_png_rgb(const char* path, uint8_t** data, int* widthp, int* heightp)
+{
+	PROF_ZONE("mud_load_png_rgb");
+	return load_png(path, PNG_COLOR_TYPE_RGB, data, widthp, heightp, NULL);
 }
 
 /*
@@ -264,22 +262,57 @@ void mud_load_png_rgba(const char* rel, void** data, int* widthp, int* heightp)
 
 int mud_load_msh(const char* path, struct msh* msh)
 {
-	struct stat st;
+	PROF_ZONE("mud_load_msh");
+
 	int fd = open(path, O_RDONLY);
-	if (fd == -1) arghf("%s: %s", path, strerror(errno));
+	if (fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct stat st;
 	int e = fstat(fd, &st);
 	if (e == -1) arghf("%s: %s", path, strerror(errno));
 
-	msh->_data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-	ASSERT(msh->_data != MAP_FAILED);
+	/* read rather than mmap; the file might get rewritten by the exporter
+	 * while we're still using the old mesh */
+	size_t n = st.st_size / sizeof(int32_t);
+	int32_t* iptr = malloc(n * sizeof(int32_t) + 1);
+	AN(iptr);
+	if (readn(fd, iptr, n * sizeof(int32_t)) == -1) {
+		fprintf(stderr, "%s: %s\n", path, errno ? strerror(errno) : "unexpected end of file");
+		free(iptr);
+		close(fd);
+		return -1;
+	}
+	mud_close(fd);
 
-	int32_t* iptr = (int32_t*)msh->_data;
-	msh->n_vertices = iptr[0];
-	msh->vertices = (float*)&iptr[1];
+	// (the exporter might not be done with it)
+	int64_t n_vertices = n > 0 ? iptr[0] : -1;
+	int64_t offset = n_vertices*5+1;
+	int64_t n_indices = n_vertices >= 0 && offset < n ? iptr[offset] : -1;
+	int valid = n_indices >= 0 && offset+1+n_indices <= n;
+	for (int64_t i = 0; valid && i < n_indices; i++) {
+		int32_t index = iptr[offset+1+i];
+		if (index < 0 || index >= n_vertices) valid = 0;
+	}
+	if (!valid) {
+		fprintf(stderr, "%s: not a valid mesh\n", path);
+		free(iptr);
+		return -1;
+	}
 
-	int offset = msh->n_vertices*5+1;
-	msh->n_indices = iptr[offset];
+	msh->_data = iptr;
+	msh->n_vertices = n_vertices;
+	msh->vertices = (float*)&iptr[1];
+	msh->n_indices = n_indices;
 	msh->indices = (int32_t*)&iptr[offset+1];
 
 	return 0;
 }
+
+void mud_free_msh(struct msh* msh)
+{
+	free(msh->_data);
+	msh->_data = NULL;
+}
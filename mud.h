@@ -9,6 +9,9 @@ int mud_open(const char* pathname);
 void mud_readn(int fd, void* vbuf, size_t count);
 void mud_close(int fd);
 
+/* the loaders return -1 (having said why on stderr) if the file is missing,
+ * short or malformed, so hot reloading can skip a file that's being
+ * written; startup code just AZ()s them */
 int mud_load_png_palette(const char* path, uint8_t* palette);
 int mud_load_png_paletted(const char* path, uint8_t** data, int* widthp, int* heightp);
 int mud_load_png_rgb(const char* path, uint8_t** data, int* widthp, int* heightp);
@@ -23,5 +26,6 @@ struct msh {
 };
 
 int mud_load_msh(const char* path, struct msh* msh);
+void mud_free_msh(struct msh* msh);
 
 #endif//__MUD_H__
@@ -3,76 +3,88 @@
 #include "names.h"
 #include "a.h"
 
-const char* names_flats[] = { "flat0", "flat1", "glowflat", NULL };
+#include "dnames.inc.h"
 
-int names_number_of_flats()
+static int find(const char* name, const char** names, uint32_t seed, uint32_t mask, const int16_t* slots)
 {
-	int i = 0;
-	for (const char** flat = names_flats; *flat; flat++) i++;
+	int i = slots[names_hash(seed, name) & mask];
+	if (i == -1 || strcmp(name, names[i]) != 0) return -1;
 	return i;
 }
 
+#define FLATDEF(name) name,
+#define WALLDEF(name)
+#define SPRITEDEF(name)
+const char* names_flats[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
+
+int names_number_of_flats()
+{
+	return sizeof(names_flats) / sizeof(*names_flats) - 1;
+}
+
 int names_find_flat(const char* name)
 {
-	int i = 0;
-	for (const char** flat = names_flats; *flat; flat++) {
-		if (strcmp(name, *flat) == 0) {
-			return i;
-		}
-		i++;
-	}
-	arghf("flat '%s' not found\n", name);
+	int i = find(name, names_flats, names_flats_seed, names_flats_mask, names_flats_slots);
+	if (i == -1) arghf("flat '%s' not found\n", name);
+	return i;
 }
 
 
-const char* names_walls[] = { "wall0", "wall1", NULL };
+#define FLATDEF(name)
+#define WALLDEF(name) name,
+#define SPRITEDEF(name)
+const char* names_walls[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
 
 int names_number_of_walls()
 {
-	int i = 0;
-	for (const char** wall = names_walls; *wall; wall++) i++;
-	return i;
+	return sizeof(names_walls) / sizeof(*names_walls) - 1;
 }
 
 int names_find_wall(const char* name)
 {
-	int i = 0;
-	for (const char** wall = names_walls; *wall; wall++) {
-		if (strcmp(name, *wall) == 0) {
-			return i;
-		}
-		i++;
-	}
-	arghf("wall '%s' not found\n", name);
+	int i = find(name, names_walls, names_walls_seed, names_walls_mask, names_walls_slots);
+	if (i == -1) arghf("wall '%s' not found\n", name);
+	return i;
 }
 
 
-const char* names_sprites[] = { "sprite0", NULL };
+#define FLATDEF(name)
+#define WALLDEF(name)
+#define SPRITEDEF(name) name,
+const char* names_sprites[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
 
 int names_number_of_sprites()
 {
-	int i = 0;
-	for (const char** sprite = names_sprites; *sprite; sprite++) i++;
-	return i;
+	return sizeof(names_sprites) / sizeof(*names_sprites) - 1;
 }
 
 int names_find_sprite(const char* name)
 {
-	int i = 0;
-	for (const char** sprite = names_sprites; *sprite; sprite++) {
-		if (strcmp(name, *sprite) == 0) {
-			return i;
-		}
-		i++;
-	}
-	arghf("sprite '%s' not found\n", name);
+	int i = find(name, names_sprites, names_sprites_seed, names_sprites_mask, names_sprites_slots);
+	if (i == -1) arghf("sprite '%s' not found\n", name);
+	return i;
 }
 
 
-
-
-
-#define ENTDEF(group,type,radius) type,
+#define ENTDEF(group,type,radius,height,draw,art,flags,think) type,
 const char* names_entity_types[] = {
 	#include "entities.inc.h"
 	NULL
@@ -81,12 +93,7 @@ const char* names_entity_types[] = {
 
 int names_find_entity_type(const char* type)
 {
-	int i = 0;
-	for (const char** t = names_entity_types; *t; t++) {
-		if (strcmp(type, *t) == 0) {
-			return i;
-		}
-		i++;
-	}
-	arghf("entity type '%s' not found\n", type);
+	int i = find(type, names_entity_types, names_entity_types_seed, names_entity_types_mask, names_entity_types_slots);
+	if (i == -1) arghf("entity type '%s' not found\n", type);
+	return i;
 }
@@ -1,6 +1,13 @@
 #ifndef NAMES_H
 #define NAMES_H
 
+#include <stdint.h>
+
+/* the names of flats, walls, sprites (names.inc.h) and entity types
+ * (entities.inc.h). names_find_*() look names up in perfect hash tables
+ * that names2c generates at build time (dnames.inc.h), so that's one hash
+ * and one strcmp. they complain and exit on unknown names */
+
 int names_find_flat(const char* name);
 int names_number_of_flats();
 extern const char* names_flats[];
@@ -11,10 +18,22 @@ extern const char* names_walls[];
 
 
 int names_find_sprite(const char* name);
-int names_number_of_psrites();
+int names_number_of_sprites();
 extern const char* names_sprites[];
 
 
 int names_find_entity_type(const char* type);
+extern const char* names_entity_types[];
+
+// FNV-1a, salted; names2c searches for salts that don't collide
+static inline uint32_t names_hash(uint32_t seed, const char* name)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (const char* c = name; *c; c++) {
+		h ^= (uint8_t)*c;
+		h *= 16777619u;
+	}
+	return h ^ (h >> 15);
+}
 
 #endif/*NAMES_H*/
@@ -0,0 +1,9 @@
+// (name); the order is the index levels and the editor refer to
+FLATDEF("flat0")
+FLATDEF("flat1")
+FLATDEF("glowflat")
+
+WALLDEF("wall0")
+WALLDEF("wall1")
+
+SPRITEDEF("sprite0")
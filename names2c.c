@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "names.h"
+
+/* writes dnames.inc.h: a perfect hash for each name table. its slots map
+ * names_hash(seed, name) & mask to the name's index (or -1); no two names
+ * share a slot */
+
+#define FLATDEF(name) name,
+#define WALLDEF(name)
+#define SPRITEDEF(name)
+static const char* flats[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
+
+#define FLATDEF(name)
+#define WALLDEF(name) name,
+#define SPRITEDEF(name)
+static const char* walls[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
+
+#define FLATDEF(name)
+#define WALLDEF(name)
+#define SPRITEDEF(name) name,
+static const char* sprites[] = {
+	#include "names.inc.h"
+	NULL
+};
+#undef FLATDEF
+#undef WALLDEF
+#undef SPRITEDEF
+
+#define ENTDEF(group,type,radius,height,draw,art,flags,think) type,
+static const char* entity_types[] = {
+	#include "entities.inc.h"
+	NULL
+};
+#undef ENTDEF
+
+#define MAX_SEEDS (1<<16) // tried per table size, before doubling it
+
+static int try_seed(const char** names, int n, uint32_t seed, uint32_t mask, int* slots)
+{
+	for (int i = 0; i <= mask; i++) slots[i] = -1;
+	for (int i = 0; i < n; i++) {
+		uint32_t h = names_hash(seed, names[i]) & mask;
+		if (slots[h] != -1) return 0;
+		slots[h] = i;
+	}
+	return 1;
+}
+
+static void emit(const char* table, const char** names)
+{
+	int n = 0;
+	while (names[n]) n++;
+
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < i; j++) {
+			if (strcmp(names[i], names[j]) == 0) {
+				fprintf(stderr, "%s: '%s' is there twice\n", table, names[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// at most half full; a lot of salts work then
+	uint32_t size = 2;
+	while (size < 2*n) size *= 2;
+	for (;;) {
+		int* slots = malloc(size * sizeof(*slots));
+		if (slots == NULL) {
+			fprintf(stderr, "%s: out of memory\n", table);
+			exit(EXIT_FAILURE);
+		}
+		for (uint32_t seed = 0; seed < MAX_SEEDS; seed++) {
+			if (!try_seed(names, n, seed, size-1, slots)) continue;
+			printf("static const uint32_t names_%s_seed = %uu;\n", table, seed);
+			printf("static const uint32_t names_%s_mask = %uu;\n", table, size-1);
+			printf("static const int16_t names_%s_slots[] = {", table);
+			for (uint32_t i = 0; i < size; i++) printf("%s%d", i ? "," : "", slots[i]);
+			printf("};\n\n");
+			free(slots);
+			return;
+		}
+		free(slots);
+		size *= 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	printf("// generated by names2c from names.inc.h and entities.inc.h\n\n");
+	emit("flats", flats);
+	emit("walls", walls);
+	emit("sprites", sprites);
+	emit("entity_types", entity_types);
+	return 0;
+}
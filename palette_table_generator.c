@@ -18,7 +18,7 @@ int main(int argc, char** argv)
 	}
 
 	uint8_t palette[768];
-	mud_load_png_palette(argv[1], palette);
+	AZ(mud_load_png_palette(argv[1], palette));
 
 	int unicorns = 1;
 
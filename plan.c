@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "plan.h"
+#include "llvl.h"
+#include "a.h"
+
+// Park-Miller; must match the generator in lua/build.lua
+#define RNG_M (2147483647)
+#define RNG_A (16807)
+
+static uint32_t rng_next(uint32_t s)
+{
+	return (uint64_t)s * RNG_A % RNG_M;
+}
+
+// the state after n steps
+static uint32_t rng_skip(uint32_t s, uint32_t n)
+{
+	uint64_t a = RNG_A;
+	uint64_t r = s;
+	while (n) {
+		if (n & 1) r = r * a % RNG_M;
+		a = a * a % RNG_M;
+		n >>= 1;
+	}
+	return r;
+}
+
+/* same outcome as pick1(list) in lua/build.lua: only the first swap of the
+ * shuffle decides the pick, but the shuffle draws n numbers */
+static uint32_t rng_pick(struct plan* plan, uint32_t n)
+{
+	ASSERT(n > 0);
+	uint32_t i = rng_next(plan->rng) % n;
+	plan->rng = rng_skip(plan->rng, n);
+	return i;
+}
+
+void plan_init(struct plan* plan, uint32_t rng)
+{
+	memset(plan, 0, sizeof(*plan));
+	plan->rng = rng;
+}
+
+void plan_free(struct plan* plan)
+{
+	for (int i = 0; i < plan->n_bricks; i++) {
+		struct plan_brick* brick = &plan->bricks[i];
+		free(brick->name);
+		free(brick->portals);
+		lvl_free(&brick->lvl);
+	}
+	free(plan->bricks);
+	free(plan->placements);
+	free(plan->portals);
+	memset(plan, 0, sizeof(*plan));
+}
+
+static void* grow(void* data, uint32_t* reserved, uint32_t n, size_t elem_sz)
+{
+	if (n <= *reserved) return data;
+	uint32_t r = *reserved ? *reserved : 16;
+	while (r < n) r *= 2;
+	data = realloc(data, r * elem_sz);
+	AN(data);
+	*reserved = r;
+	return data;
+}
+
+static int32_t find_brick(struct plan* plan, const char* name)
+{
+	for (int i = 0; i < plan->n_bricks; i++) {
+		if (strcmp(plan->bricks[i].name, name) == 0) return i;
+	}
+
+	plan->bricks = grow(plan->bricks, &plan->reserved_bricks, plan->n_bricks + 1, sizeof(struct plan_brick));
+	int32_t i = plan->n_bricks++;
+	struct plan_brick* brick = &plan->bricks[i];
+	memset(brick, 0, sizeof(*brick));
+
+	size_t name_sz = strlen(name) + 1;
+	brick->name = malloc(name_sz);
+	AN(brick->name);
+	memcpy(brick->name, name, name_sz);
+
+	int32_t* portal_tags;
+	llvl_load_brick(name, &brick->lvl, &portal_tags);
+
+	brick->portals = malloc(brick->lvl.n_linedefs * sizeof(int32_t));
+	AN(brick->portals);
+	for (int j = 0; j < brick->lvl.n_linedefs; j++) {
+		if (portal_tags[j] != PLAN_PORTAL_TAG) continue;
+		struct lvl_linedef* ld = lvl_get_linedef(&brick->lvl, j);
+		if (ld->sidedef[0] != -1 && ld->sidedef[1] != -1) {
+			arghf("two-sided linedef %d cannot be a portal in '%s'", j+1, name);
+		}
+		brick->portals[brick->n_portals++] = j;
+	}
+	free(portal_tags);
+
+	return i;
+}
+
+/* the vertices of a one-sided portal, ordered as seen from the given side,
+ * and the floor z of its sector */
+static void portal_ends(struct lvl* lvl, int32_t linedef, int side, int32_t* v0, int32_t* v1, float* z0)
+{
+	struct lvl_linedef* ld = lvl_get_linedef(lvl, linedef);
+	int s = ld->sidedef[1] != -1;
+	*v0 = ld->vertex[(side + s) & 1];
+	*v1 = ld->vertex[(side + s + 1) & 1];
+	*z0 = lvl_get_sector(lvl, lvl_get_sidedef(lvl, ld->sidedef[s])->sector)->flat[0].z;
+}
+
+// the similarity (rotation, scale, translation) that maps a0->b0 and a1->b1
+static void map_segment(struct mat23* tx, struct vec2* a0, struct vec2* a1, struct vec2* b0, struct vec2* b1)
+{
+	float ax = a1->s[0] - a0->s[0];
+	float ay = a1->s[1] - a0->s[1];
+	float bx = b1->s[0] - b0->s[0];
+	float by = b1->s[1] - b0->s[1];
+	float d = ax*ax + ay*ay;
+	ASSERT(d > 0);
+	float re = (bx*ax + by*ay) / d;
+	float im = (by*ax - bx*ay) / d;
+	tx->s[0] = re;
+	tx->s[1] = im;
+	tx->s[2] = -im;
+	tx->s[3] = re;
+	tx->s[4] = b0->s[0] - (re * a0->s[0] - im * a0->s[1]);
+	tx->s[5] = b0->s[1] - (im * a0->s[0] + re * a0->s[1]);
+}
+
+// (level coordinates are kept integral, like the Lua builder did)
+static void apply_snapped(struct mat23* tx, struct vec2* dst, struct vec2* src)
+{
+	mat23_apply(tx, dst, src);
+	dst->s[0] = rintf(dst->s[0]);
+	dst->s[1] = rintf(dst->s[1]);
+}
+
+static void add_portal(struct plan* plan, int32_t linedef, int32_t placement, int32_t brick_linedef)
+{
+	plan->portals = grow(plan->portals, &plan->reserved_portals, plan->n_portals + 1, sizeof(struct plan_portal));
+	struct plan_portal* portal = &plan->portals[plan->n_portals++];
+	portal->linedef = linedef;
+	portal->placement = placement;
+	portal->brick_linedef = brick_linedef;
+}
+
+static void remove_portal(struct plan* plan, uint32_t i)
+{
+	ASSERT(i < plan->n_portals);
+	memmove(&plan->portals[i], &plan->portals[i+1], (plan->n_portals - i - 1) * sizeof(struct plan_portal));
+	plan->n_portals--;
+}
+
+/* where a placed brick's portal ends up; the same as portal_ends() on the
+ * level, as shared vertices snap to the same place */
+static void placed_portal_ends(struct plan* plan, int32_t placementi, int32_t linedef, int side, struct vec2* v0, struct vec2* v1, float* z0)
+{
+	struct plan_placement* p = &plan->placements[placementi];
+	struct lvl* src = &plan->bricks[p->brick].lvl;
+	int32_t v0i, v1i;
+	portal_ends(src, linedef, side, &v0i, &v1i, z0);
+	apply_snapped(&p->tx, v0, lvl_get_vertex(src, v0i));
+	apply_snapped(&p->tx, v1, lvl_get_vertex(src, v1i));
+	*z0 += p->dz;
+}
+
+int32_t plan_place_brick(struct plan* plan, const char* name)
+{
+	int32_t bricki = find_brick(plan, name);
+	struct plan_brick* brick = &plan->bricks[bricki];
+	struct lvl* src = &brick->lvl;
+
+	int32_t placementi = plan->n_placements;
+	plan->placements = grow(plan->placements, &plan->reserved_placements, plan->n_placements + 1, sizeof(struct plan_placement));
+	struct plan_placement* p = &plan->placements[plan->n_placements++];
+	memset(p, 0, sizeof(*p));
+	p->brick = bricki;
+	p->parent = -1;
+	p->portal = -1;
+	p->parent_portal = -1;
+	p->brick_portal = -1;
+	mat23_set_identity(&p->tx);
+
+	int first = placementi == 0;
+
+	if (!first) {
+		if (plan->n_portals == 0) arghf("no portals in level for '%s'", name);
+		if (brick->n_portals == 0) arghf("no portals in '%s'", name);
+
+		uint32_t si = rng_pick(plan, plan->n_portals);
+		p->portal = plan->portals[si].linedef;
+		p->parent = plan->portals[si].placement;
+		p->parent_portal = plan->portals[si].brick_linedef;
+		remove_portal(plan, si);
+
+		p->brick_portal = brick->portals[rng_pick(plan, brick->n_portals)];
+
+		struct vec2 sv0, sv1;
+		float sz0;
+		placed_portal_ends(plan, p->parent, p->parent_portal, 0, &sv0, &sv1, &sz0);
+		int32_t bv0i, bv1i;
+		float bz0;
+		portal_ends(src, p->brick_portal, 1, &bv0i, &bv1i, &bz0);
+
+		map_segment(
+			&p->tx,
+			lvl_get_vertex(src, bv0i), lvl_get_vertex(src, bv1i),
+			&sv0, &sv1);
+		p->dz = sz0 - bz0;
+	}
+
+	// (the joined portal's linedef and vertices are the parent's)
+	struct plan_range* r = &p->range;
+	struct plan_range* t = &plan->total;
+	r->sector0 = t->sector0 + t->n_sectors;
+	r->n_sectors = src->n_sectors;
+	r->linedef0 = t->linedef0 + t->n_linedefs;
+	r->n_linedefs = src->n_linedefs - !first;
+	r->sidedef0 = t->sidedef0 + t->n_sidedefs;
+	r->n_sidedefs = src->n_sidedefs;
+	r->vertex0 = t->vertex0 + t->n_vertices;
+	r->n_vertices = src->n_vertices - (first ? 0 : 2);
+	r->entity0 = t->entity0 + t->n_entities;
+	r->n_entities = src->n_entities;
+	t->n_sectors += r->n_sectors;
+	t->n_linedefs += r->n_linedefs;
+	t->n_sidedefs += r->n_sidedefs;
+	t->n_vertices += r->n_vertices;
+	t->n_entities += r->n_entities;
+
+	/* the brick's remaining portals are open. linedefs were appended in
+	 * order, so the index stays sorted */
+	for (int i = 0; i < brick->n_portals; i++) {
+		int32_t bld = brick->portals[i];
+		if (bld == p->brick_portal) continue;
+		add_portal(plan, r->linedef0 + bld - (p->brick_portal != -1 && bld > p->brick_portal), placementi, bld);
+	}
+
+	return placementi;
+}
+
+void plan_instantiate(struct plan* plan, int32_t placementi, struct lvl* lvl, int32_t join, struct plan_range* range)
+{
+	struct plan_placement* p = &plan->placements[placementi];
+	struct plan_brick* brick = &plan->bricks[p->brick];
+	struct lvl* src = &brick->lvl;
+
+	range->sector0 = lvl->n_sectors;
+	range->linedef0 = lvl->n_linedefs;
+	range->sidedef0 = lvl->n_sidedefs;
+	range->vertex0 = lvl->n_vertices;
+	range->entity0 = lvl->n_entities;
+
+	int32_t sportal = join, bportal = -1;
+	int32_t sv0i = -1, sv1i = -1, bv0i = -1, bv1i = -1;
+	if (join != -1) {
+		ASSERT(p->brick_portal != -1);
+		bportal = p->brick_portal;
+		float sz0, bz0;
+		portal_ends(lvl, sportal, 0, &sv0i, &sv1i, &sz0);
+		portal_ends(src, bportal, 1, &bv0i, &bv1i, &bz0);
+	}
+
+	uint32_t vertex0 = lvl->n_vertices;
+	uint32_t sidedef0 = lvl->n_sidedefs;
+	uint32_t sector0 = lvl->n_sectors;
+
+	for (int i = 0; i < src->n_vertices; i++) {
+		if (i == bv0i || i == bv1i) continue;
+		uint32_t vi = lvl_new_vertex(lvl);
+		apply_snapped(&p->tx, lvl_get_vertex(lvl, vi), lvl_get_vertex(src, i));
+	}
+
+	for (int i = 0; i < src->n_linedefs; i++) {
+		struct lvl_linedef* bld = lvl_get_linedef(src, i);
+
+		if (i == bportal) {
+			// join the brick's portal side onto the level's portal
+			struct lvl_linedef* sld = lvl_get_linedef(lvl, sportal);
+			int c = 0;
+			for (int a = 0; a < 2; a++) {
+				for (int b = 0; b < 2; b++) {
+					if (sld->sidedef[a] == -1 && bld->sidedef[b] != -1) {
+						sld->sidedef[a] = bld->sidedef[b] + sidedef0;
+						c++;
+					}
+				}
+			}
+			if (c != 1) arghf("expected exactly one sidedef to join at the portal of '%s'", brick->name);
+			continue;
+		}
+
+		uint32_t ldi = lvl_new_linedef(lvl);
+		struct lvl_linedef* ld = lvl_get_linedef(lvl, ldi);
+		for (int j = 0; j < 2; j++) {
+			int32_t v = bld->vertex[j];
+			if (v == bv0i) {
+				ld->vertex[j] = sv0i;
+			} else if (v == bv1i) {
+				ld->vertex[j] = sv1i;
+			} else {
+				// (skipping the two shared vertices)
+				ld->vertex[j] = vertex0 + v - (bv0i != -1 && v > bv0i) - (bv1i != -1 && v > bv1i);
+			}
+			ld->sidedef[j] = bld->sidedef[j] == -1 ? -1 : bld->sidedef[j] + sidedef0;
+		}
+	}
+
+	for (int i = 0; i < src->n_sidedefs; i++) {
+		struct lvl_sidedef* sd = lvl_get_sidedef(lvl, lvl_new_sidedef(lvl));
+		memcpy(sd, lvl_get_sidedef(src, i), sizeof(*sd));
+		sd->sector += sector0;
+	}
+
+	for (int i = 0; i < src->n_sectors; i++) {
+		struct lvl_sector* sector = lvl_get_sector(lvl, lvl_new_sector(lvl));
+		memcpy(sector, lvl_get_sector(src, i), sizeof(*sector));
+		for (int j = 0; j < 2; j++) sector->flat[j].z += p->dz;
+		sector->contour0 = -1;
+		sector->contourn = 0;
+	}
+
+	float rotation = atan2f(p->tx.s[1], p->tx.s[0]) * (180.0f / M_PI);
+	for (int i = 0; i < src->n_entities; i++) {
+		struct lvl_entity* e = lvl_get_entity(lvl, lvl_new_entity(lvl));
+		memcpy(e, lvl_get_entity(src, i), sizeof(*e));
+		apply_snapped(&p->tx, &e->position, &lvl_get_entity(src, i)->position);
+		e->yaw += rotation;
+	}
+
+	range->n_sectors = lvl->n_sectors - range->sector0;
+	range->n_linedefs = lvl->n_linedefs - range->linedef0;
+	range->n_sidedefs = lvl->n_sidedefs - range->sidedef0;
+	range->n_vertices = lvl->n_vertices - range->vertex0;
+	range->n_entities = lvl->n_entities - range->entity0;
+}
+
+void plan_insert_brick(struct plan* plan, struct lvl* lvl, const char* name)
+{
+	int32_t placementi = plan_place_brick(plan, name);
+	struct plan_placement* p = &plan->placements[placementi];
+	struct plan_range range;
+	plan_instantiate(plan, placementi, lvl, p->portal, &range);
+	AZ(memcmp(&range, &p->range, sizeof(range)));
+}
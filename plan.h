@@ -0,0 +1,90 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdint.h>
+
+#include "lvl.h"
+#include "m.h"
+
+/* brick composition. plans (lua/plans/) are evaluated in Lua into a flat
+ * list of brick names; the bricks are then appended to the level here, each
+ * one attached to a randomly picked open portal of the level so far.
+ * bricks are loaded once into templates, and the level's open portals are
+ * kept in an index, so a brick is inserted in time proportional to its own
+ * size.
+ *
+ * placing a brick (working out where it goes) only needs the templates, so
+ * a plan can be laid out without building the whole level, and any subset
+ * of its placements instantiated later (see world.h) */
+
+#define PLAN_PORTAL_TAG (0) // "portal_0"
+
+struct plan_brick {
+	char* name;
+	struct lvl lvl;
+	uint32_t n_portals;
+	int32_t* portals; // linedefs tagged PLAN_PORTAL_TAG, ascending
+};
+
+// what a brick occupies in a level
+struct plan_range {
+	uint32_t sector0, n_sectors;
+	uint32_t linedef0, n_linedefs;
+	uint32_t sidedef0, n_sidedefs;
+	uint32_t vertex0, n_vertices;
+	uint32_t entity0, n_entities;
+};
+
+// where a brick goes
+struct plan_placement {
+	int32_t brick;
+	int32_t parent; // placement it's attached to, or -1 for the first
+	int32_t portal; // level linedef shared with the parent, or -1
+	int32_t parent_portal; // that linedef in the parent's brick
+	int32_t brick_portal; // this brick's linedef that's joined onto it
+
+	struct mat23 tx;
+	float dz;
+
+	struct plan_range range; // in the whole level
+};
+
+struct plan_portal {
+	int32_t linedef;
+	int32_t placement;
+	int32_t brick_linedef;
+};
+
+struct plan {
+	uint32_t rng;
+
+	uint32_t n_bricks, reserved_bricks;
+	struct plan_brick* bricks;
+
+	uint32_t n_placements, reserved_placements;
+	struct plan_placement* placements;
+
+	// open portals in the level, by ascending linedef
+	uint32_t n_portals, reserved_portals;
+	struct plan_portal* portals;
+
+	struct plan_range total; // the whole level, so far
+};
+
+/* rng is the Park-Miller state lua/build.lua left off at; composition must
+ * continue its sequence to yield the same level for the same seed */
+void plan_init(struct plan* plan, uint32_t rng);
+void plan_free(struct plan* plan);
+
+// loads (once) and inserts a brick into lvl; arghf()s on errors
+void plan_insert_brick(struct plan* plan, struct lvl* lvl, const char* name);
+
+// plan_insert_brick() without the level; returns the placement index
+int32_t plan_place_brick(struct plan* plan, const char* name);
+
+/* appends a placement's geometry to lvl, and says where it went. join is
+ * the lvl linedef of the parent's portal, to join the brick's portal onto
+ * (sharing its vertices), or -1 to leave the brick's portal a wall */
+void plan_instantiate(struct plan* plan, int32_t placementi, struct lvl* lvl, int32_t join, struct plan_range* range);
+
+#endif/*PLAN_H*/
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "prof.h"
+#include "a.h"
+
+#ifdef TRACE
+
+struct prof_event {
+	const char* name;
+	uint64_t t0, t1;
+};
+
+struct prof_ring {
+	int used; // claimed by a running thread
+	const char* thread;
+	uint64_t n; // zones ever written; the last PROF_RING_SIZE are kept
+	struct prof_event* events;
+};
+
+static struct prof_ring rings[PROF_MAX_THREADS];
+static __thread struct prof_ring* ring;
+
+uint64_t prof_now(void)
+{
+	struct timespec ts;
+	AZ(clock_gettime(CLOCK_MONOTONIC, &ts));
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int try_claim(struct prof_ring* r, const char* name)
+{
+	if (!__sync_bool_compare_and_swap(&r->used, 0, 1)) return 0;
+	if (r->events == NULL) {
+		r->events = malloc(PROF_RING_SIZE * sizeof(*r->events));
+		AN(r->events);
+	}
+	r->thread = name;
+	ring = r;
+	return 1;
+}
+
+/* claims a free ring, keeping what's in it: one that was used by a thread
+ * of the same name, else a fresh one. zones on threads that don't get a
+ * ring aren't recorded */
+static void claim(const char* name)
+{
+	for (int i = 0; i < PROF_MAX_THREADS; i++) {
+		struct prof_ring* r = &rings[i];
+		if (r->thread != NULL && strcmp(r->thread, name) == 0 && try_claim(r, name)) return;
+	}
+	for (int i = 0; i < PROF_MAX_THREADS; i++) {
+		struct prof_ring* r = &rings[i];
+		if (r->thread == NULL && try_claim(r, name)) return;
+	}
+}
+
+void prof_thread_begin(const char* name)
+{
+	if (ring == NULL) claim(name);
+}
+
+void prof_thread_end(void)
+{
+	if (ring == NULL) return;
+	__sync_lock_release(&ring->used);
+	ring = NULL;
+}
+
+static void record(struct prof_ring* r, const char* name, uint64_t t0, uint64_t t1)
+{
+	struct prof_event* e = &r->events[r->n & (PROF_RING_SIZE-1)];
+	e->name = name;
+	e->t0 = t0;
+	e->t1 = t1;
+	r->n++;
+}
+
+struct prof_zone prof_zone_begin(const char* name)
+{
+	struct prof_zone zone;
+	zone.name = name;
+	zone.t0 = prof_now();
+	return zone;
+}
+
+void prof_zone_end(struct prof_zone* zone)
+{
+	uint64_t t1 = prof_now();
+	if (ring == NULL) {
+		claim("main");
+		if (ring == NULL) return;
+	}
+	record(ring, zone->name, zone->t0, t1);
+}
+
+void prof_track_zone(const char* track, const char* name, uint64_t t0, uint64_t t1)
+{
+	/* tracks are rings that are claimed, and never released, by the
+	 * main thread on its behalf */
+	struct prof_ring* self = ring;
+	ring = NULL;
+	for (int i = 0; i < PROF_MAX_THREADS; i++) {
+		struct prof_ring* r = &rings[i];
+		if (r->used && r->thread != NULL && strcmp(r->thread, track) == 0) ring = r;
+	}
+	if (ring == NULL) claim(track);
+	if (ring != NULL) record(ring, name, t0, t1);
+	ring = self;
+}
+
+static uint64_t ring_first(struct prof_ring* r)
+{
+	return r->n > PROF_RING_SIZE ? r->n - PROF_RING_SIZE : 0;
+}
+
+int prof_dump(const char* path)
+{
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	// timestamps are relative to the oldest zone kept
+	uint64_t base = UINT64_MAX;
+	for (int i = 0; i < PROF_MAX_THREADS; i++) {
+		struct prof_ring* r = &rings[i];
+		for (uint64_t j = ring_first(r); j < r->n; j++) {
+			uint64_t t0 = r->events[j & (PROF_RING_SIZE-1)].t0;
+			if (t0 < base) base = t0;
+		}
+	}
+
+	int n = 0;
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (int i = 0; i < PROF_MAX_THREADS; i++) {
+		struct prof_ring* r = &rings[i];
+		if (r->n == 0) continue;
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			n++ ? ",\n" : "", i, r->thread ? r->thread : "?");
+		for (uint64_t j = ring_first(r); j < r->n; j++) {
+			struct prof_event* e = &r->events[j & (PROF_RING_SIZE-1)];
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				e->name, i, (double)(e->t0 - base) * 1e-3, (double)(e->t1 - e->t0) * 1e-3);
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	if (fclose(f) != 0) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	printf("wrote trace to %s\n", path);
+	return 0;
+}
+
+#else
+
+int prof_dump(const char* path)
+{
+	fprintf(stderr, "%s: not written; tracing needs a TRACE=1 build\n", path);
+	return -1;
+}
+
+#endif
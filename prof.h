@@ -0,0 +1,61 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+/* scoped timers. PROF_ZONE("name") times from where it's declared to the
+ * end of the enclosing block (early returns included). zones go into a ring
+ * buffer per thread, and prof_dump() writes what the rings hold as Chrome
+ * trace JSON, for chrome://tracing or ui.perfetto.dev.
+ *
+ * only built with TRACE defined (make clean; make TRACE=1); otherwise the
+ * macros compile to nothing and prof_dump() just complains.
+ *
+ * names must be string literals (they're kept by pointer). threads other
+ * than the main one bracket their work with PROF_THREAD_BEGIN/END, so their
+ * ring can be reused by later threads. dump between frames, when worker
+ * threads are done */
+
+#define PROF_MAX_THREADS (32)
+#define PROF_RING_SIZE (1<<16) // zones kept per thread; a power of two
+
+#ifdef TRACE
+
+struct prof_zone {
+	const char* name;
+	uint64_t t0;
+};
+
+struct prof_zone prof_zone_begin(const char* name);
+void prof_zone_end(struct prof_zone* zone);
+
+void prof_thread_begin(const char* name);
+void prof_thread_end(void);
+
+// clock the zones are timed with, in ns
+uint64_t prof_now(void);
+
+/* a zone timed by other means (e.g. the GPU), on a track of its own. a
+ * track should only be written by one thread */
+void prof_track_zone(const char* track, const char* name, uint64_t t0, uint64_t t1);
+
+#define PROF__CAT2(a, b) a##b
+#define PROF__CAT(a, b) PROF__CAT2(a, b)
+
+#define PROF_ZONE(name) \
+	struct prof_zone PROF__CAT(prof__zone, __LINE__) __attribute__((cleanup(prof_zone_end))) = prof_zone_begin(name)
+#define PROF_THREAD_BEGIN(name) prof_thread_begin(name)
+#define PROF_THREAD_END() prof_thread_end()
+
+#else
+
+#define PROF_ZONE(name) do {} while (0)
+#define PROF_THREAD_BEGIN(name) do {} while (0)
+#define PROF_THREAD_END() do {} while (0)
+
+#endif
+
+// returns 0 on success, or -1 if the trace couldn't be written
+int prof_dump(const char* path);
+
+#endif/*PROF_H*/
@@ -4,13 +4,16 @@
 #include "mud.h"
 #include "runtime.h"
 #include "a.h"
+#include "prof.h"
+#include "stats.h"
+#include "frame.h"
 
-#include <tesselator.h>
 #include <GL/glew.h>
 
 
 #define FLOATS_PER_FLAT_VERTEX (8)
 #define FLOATS_PER_TYPE0_VERTEX (6)
+#define FLOATS_PER_OVERLAY_VERTEX (7)
 
 // XXX TODO should roll my own matrix stack. gl_ModelViewProjectionMatrix,
 // glLoadIdentity() and so on are all deprecated
@@ -174,6 +177,14 @@ static void render_init_palette_table(struct render* render)
 	free(palette_table);
 }
 
+static void flat_slot_origin(int slot, int* x0, int* y0)
+{
+	int flats_per_row_exp = MAGIC_FLAT_ATLAS_SIZE_EXP - MAGIC_FLAT_SIZE_EXP;
+	ASSERT(slot >= 0 && slot < (1 << (flats_per_row_exp << 1)));
+	*x0 = (slot << MAGIC_FLAT_SIZE_EXP) & (MAGIC_FLAT_ATLAS_SIZE - 1);
+	*y0 = (slot >> flats_per_row_exp) << MAGIC_FLAT_SIZE_EXP;
+}
+
 static void render_init_flats(struct render* render)
 {
 	static char path[1024];
@@ -182,8 +193,6 @@ static void render_init_flats(struct render* render)
 	uint8_t* atlas = malloc(atlas_sz);
 	AN(atlas);
 
-	int flats_per_row_exp = MAGIC_FLAT_ATLAS_SIZE_EXP - MAGIC_FLAT_SIZE_EXP;
-
 	int slot = 0;
 	for (const char** flat = names_flats; *flat; flat++) {
 		uint8_t* data;
@@ -198,9 +207,8 @@ static void render_init_flats(struct render* render)
 		ASSERT(width == MAGIC_FLAT_SIZE);
 		ASSERT(height == MAGIC_FLAT_SIZE);
 
-		ASSERT(slot < (1 << (flats_per_row_exp << 1)));
-		int x0 = (slot << MAGIC_FLAT_SIZE_EXP) & (MAGIC_FLAT_ATLAS_SIZE - 1);
-		int y0 = (slot >> flats_per_row_exp) << MAGIC_FLAT_SIZE_EXP;
+		int x0, y0;
+		flat_slot_origin(slot, &x0, &y0);
 		ASSERT(x0 <= (MAGIC_FLAT_ATLAS_SIZE - width));
 		ASSERT(y0 <= (MAGIC_FLAT_ATLAS_SIZE - height));
 		for (int y = 0; y < height; y++) {
@@ -229,20 +237,35 @@ static void render_init_flats(struct render* render)
 	free(atlas);
 }
 
-static void render_load_texture(struct render_texture* texture, char* path)
+static void render_upload_texture(struct render_texture* texture, uint8_t* data, int width, int height)
 {
-	uint8_t* data;
-
-	AZ(mud_load_png_paletted(path, &data, &texture->width, &texture->height));
-
 	int level = 0;
 	int border = 0;
 
-	glGenTextures(1, &texture->texture); CHKGL;
+	texture->width = width;
+	texture->height = height;
+
+	if (!texture->texture) {
+		glGenTextures(1, &texture->texture); CHKGL;
+	}
 	glBindTexture(GL_TEXTURE_2D, texture->texture); CHKGL;
 	glTexImage2D(GL_TEXTURE_2D, level, 1, texture->width, texture->height, border, GL_RED, GL_UNSIGNED_BYTE, data); CHKGL;
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); CHKGL;
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
+}
+
+static void render_load_texture(struct render_texture* texture, char* path)
+{
+	PROF_ZONE("render_load_texture");
+
+	uint8_t* data;
+	int width = 0;
+	int height = 0;
+
+	AZ(mud_load_png_paletted(path, &data, &width, &height));
+
+	texture->texture = 0;
+	render_upload_texture(texture, data, width, height);
 
 	free(data);
 }
@@ -359,8 +382,6 @@ static void render_init_shaders(struct render* render)
 	glUseProgram(0);
 }
 
-#define RENDER_BUFSZ (16384)
-
 static void static_quad_buffers(GLuint* vertex_buffer, GLuint* index_buffer, int width, int height)
 {
 	glGenBuffers(1, vertex_buffer); CHKGL;
@@ -402,47 +423,21 @@ static void static_quad_buffers(GLuint* vertex_buffer, GLuint* index_buffer, int
 
 static void render_init_buffers(struct render* render)
 {
-	// flat buffers
-	glGenBuffers(1, &render->flat_vertex_buffer); CHKGL;
-	glBindBuffer(GL_ARRAY_BUFFER, render->flat_vertex_buffer); CHKGL;
-	size_t flat_vertex_data_sz = RENDER_BUFSZ * sizeof(float) * FLOATS_PER_FLAT_VERTEX;
-	render->flat_vertex_data = malloc(flat_vertex_data_sz);
-	AN(render->flat_vertex_data);
-	glBufferData(GL_ARRAY_BUFFER, flat_vertex_data_sz, render->flat_vertex_data, GL_STREAM_DRAW); CHKGL;
-
-	glGenBuffers(1, &render->flat_index_buffer); CHKGL;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render->flat_index_buffer); CHKGL;
-	size_t flat_index_data_sz = RENDER_BUFSZ * sizeof(uint32_t);
-	render->flat_index_data = malloc(flat_index_data_sz);
-	AN(render->flat_index_data);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, flat_index_data_sz, render->flat_index_data, GL_STREAM_DRAW); CHKGL;
-
-	// wall buffers
-	glGenBuffers(1, &render->type0_vertex_buffer); CHKGL;
-	glBindBuffer(GL_ARRAY_BUFFER, render->type0_vertex_buffer); CHKGL;
-	size_t wall_vertex_data_sz = RENDER_BUFSZ * sizeof(float) * FLOATS_PER_TYPE0_VERTEX;
-	render->type0_vertex_data = malloc(wall_vertex_data_sz);
-	AN(render->type0_vertex_data);
-	glBufferData(GL_ARRAY_BUFFER, wall_vertex_data_sz, render->type0_vertex_data, GL_STREAM_DRAW); CHKGL;
-
-	glGenBuffers(1, &render->type0_index_buffer); CHKGL;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render->type0_index_buffer); CHKGL;
-	size_t wall_index_data_sz = RENDER_BUFSZ * sizeof(uint32_t);
-	render->type0_index_data = malloc(wall_index_data_sz);
-	AN(render->type0_index_data);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, wall_index_data_sz, render->type0_index_data, GL_STREAM_DRAW); CHKGL;
+	// (streams start small and grow to whatever the levels need)
+	stream_init(&render->flat_vertices, GL_ARRAY_BUFFER, sizeof(float) * FLOATS_PER_FLAT_VERTEX, 4096);
+	stream_init(&render->flat_indices, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t), 8192);
+	stream_init(&render->type0_vertices, GL_ARRAY_BUFFER, sizeof(float) * FLOATS_PER_TYPE0_VERTEX, 4096);
+	stream_init(&render->type0_indices, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t), 8192);
 
 	// step buffers
 	static_quad_buffers(&render->step_vertex_buffer, &render->step_index_buffer, MAGIC_RWIDTH, MAGIC_RHEIGHT);
 }
 
-static void render_init_tagstuff(struct render* render)
+static void render_init_overlay(struct render* render)
 {
-	render->tags_flat_vertices = malloc(sizeof(struct vec3) * RENDER_BUFSZ);
-	AN(render->tags_flat_vertices);
-
-	render->tags_flat_indices = malloc(sizeof(int) * RENDER_BUFSZ);
-	AN(render->tags_flat_indices);
+	stream_init(&render->overlay_vertices, GL_ARRAY_BUFFER, sizeof(float) * FLOATS_PER_OVERLAY_VERTEX, 256);
+	render->overlay_valid = 0;
+	render->overlay_generation = 0;
 }
 
 void render_init(struct render* render, SDL_Window* window)
@@ -458,48 +453,109 @@ void render_init(struct render* render, SDL_Window* window)
 	render_init_framebuffers(render);
 	render_init_shaders(render);
 	render_init_buffers(render);
-	render_init_tagstuff(render);
+	render_init_overlay(render);
 
-	mud_load_msh("workbench/nomnom/nomnom-v2.msh", &render->nomnom_msh);
+	render->alpha = 1;
+
+	flat_cache_init(&render->flat_cache);
+	gpu_timer_init(&render->gpu);
+
+	AZ(mud_load_msh("workbench/nomnom/nomnom-v2.msh", &render->nomnom_msh));
 	render_load_texture(&render->nomnom_texture, "workbench/nomnom/x.png");
 	//printf("%dx%d\n", render->nomnom_texture.width, render->nomnom_texture.height);
 }
 
+void render_adopt_flats(struct render* render, struct flat_cache* fc)
+{
+	flat_cache_free(&render->flat_cache);
+	memcpy(&render->flat_cache, fc, sizeof(*fc));
+	flat_cache_init(fc);
+	render->overlay_valid = 0;
+}
+
+void render_reload(struct render* render, struct watch_asset* asset)
+{
+	switch (asset->kind) {
+		case WATCH_FLAT: {
+			if (asset->width != MAGIC_FLAT_SIZE || asset->height != MAGIC_FLAT_SIZE) {
+				fprintf(stderr, "flat %s is %dx%d; expected %dx%d; ignoring\n",
+					names_flats[asset->index],
+					asset->width, asset->height,
+					MAGIC_FLAT_SIZE, MAGIC_FLAT_SIZE);
+				break;
+			}
+			// patch the slot in place rather than rebuilding the atlas
+			int x0, y0;
+			flat_slot_origin(asset->index, &x0, &y0);
+			glBindTexture(GL_TEXTURE_2D, render->flatlas_texture); CHKGL;
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1); CHKGL;
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, asset->width, asset->height, GL_RED, GL_UNSIGNED_BYTE, asset->data); CHKGL;
+		} break;
+		case WATCH_WALL:
+			ASSERT(asset->index < MAX_WALLS);
+			render_upload_texture(&render->walls[asset->index], asset->data, asset->width, asset->height);
+			break;
+		case WATCH_SPRITE:
+			ASSERT(asset->index < MAX_SPRITES);
+			render_upload_texture(&render->sprites[asset->index], asset->data, asset->width, asset->height);
+			break;
+		case WATCH_NOMNOM_TEXTURE:
+			render_upload_texture(&render->nomnom_texture, asset->data, asset->width, asset->height);
+			break;
+		case WATCH_NOMNOM_MSH:
+			mud_free_msh(&render->nomnom_msh);
+			memcpy(&render->nomnom_msh, &asset->msh, sizeof(struct msh));
+			break;
+		case WATCH_PALETTE_TABLE:
+			if (asset->width != 256 || asset->height != MAGIC_NUM_LIGHT_LEVELS) {
+				fprintf(stderr, "palette table is %dx%d; ignoring\n", asset->width, asset->height);
+				break;
+			}
+			glBindTexture(GL_TEXTURE_2D, render->palette_lookup_texture); CHKGL;
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, asset->width, asset->height, GL_RGB, GL_UNSIGNED_BYTE, asset->data); CHKGL;
+			break;
+		default:
+			break;
+	}
+}
+
 void render_set_entity_cam(struct render* render, struct lvl_entity* entity)
 {
 	render->entity_cam = entity;
 }
 
-float render_get_fovy(struct render* render)
+void render_set_alpha(struct render* render, float alpha)
 {
-	AN(render);
-	return 65;
+	render->alpha = alpha;
 }
 
-
-static void* tess_alloc(void* usr, unsigned int sz)
+static void print_stream_stats(const char* name, struct stream* s)
 {
-	//printf("my_malloc(%u)\n", sz);
-	return malloc(sz);
+	printf("  %-18s peak %8u of %8u (%zu bytes each)\n", name, s->peak, s->reserved, s->elem_sz);
 }
 
-static void* tess_realloc(void* usr, void* ptr, unsigned int sz)
+void render_print_stats(struct render* render)
 {
-	//printf("my_realloc(%u)\n", sz);
-	return realloc(ptr, sz);
+	printf("render streams:\n");
+	print_stream_stats("flat vertices", &render->flat_vertices);
+	print_stream_stats("flat indices", &render->flat_indices);
+	print_stream_stats("type0 vertices", &render->type0_vertices);
+	print_stream_stats("type0 indices", &render->type0_indices);
+	print_stream_stats("overlay vertices", &render->overlay_vertices);
+	printf("frame memory: peak %zu bytes\n", frame_peak());
+	gpu_timer_print(&render->gpu);
 }
 
-static void tess_free(void* usr, void* ptr)
+float render_get_fovy(struct render* render)
 {
-	//printf("my_free()\n");
-	return free(ptr);
+	AN(render);
+	return 65;
 }
 
 
 static void renderctx_add_flat_vertex(struct render* render, float x, float y, float z, float u, float v)
 {
-	ASSERT(render->flat_vertex_n < RENDER_BUFSZ);
-	float* data = &render->flat_vertex_data[render->flat_vertex_n * FLOATS_PER_FLAT_VERTEX];
+	float* data = stream_push(&render->flat_vertices, 1);
 	int i = 0;
 	data[i++] = x;
 	data[i++] = y;
@@ -510,7 +566,6 @@ static void renderctx_add_flat_vertex(struct render* render, float x, float y, f
 	data[i++] = render->current_select_v;
 	data[i++] = render->current_light_level;
 	//printf("%f %f %f\n", x, y, z);
-	render->flat_vertex_n++;
 }
 
 static void resolve_select(int i, float* select_u, float* select_v)
@@ -522,7 +577,7 @@ static void resolve_select(int i, float* select_u, float* select_v)
 
 static void renderctx_begin_flat(struct render* render, struct lvl* lvl, int sectori, int flati)
 {
-	render->flat_offset = render->flat_vertex_n;
+	render->flat_offset = render->flat_vertices.n;
 	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
 	struct lvl_flat* flat = &sector->flat[flati];
 
@@ -532,83 +587,23 @@ static void renderctx_begin_flat(struct render* render, struct lvl* lvl, int sec
 
 static void renderctx_add_flat_triangle(struct render* render, uint32_t indices[3])
 {
-	ASSERT((render->flat_index_n+3) <= RENDER_BUFSZ);
+	uint32_t* data = stream_push(&render->flat_indices, 3);
 	for (int i = 0; i < 3; i++) {
-		render->flat_index_data[render->flat_index_n++] = render->flat_offset + indices[i];
+		data[i] = render->flat_offset + indices[i];
 	}
 }
 
-static void yield_flat_partial(struct render* render, struct lvl* lvl, int sectori, int flati)
+static void yield_flat_partial(struct render* render, struct lvl* lvl, int sectori, int flati, struct flat_mesh* mesh)
 {
 	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
 	struct lvl_flat* flat = &sector->flat[flati];
 
-	TESSalloc ta;
-
-	ta.memalloc = tess_alloc;
-	ta.memrealloc = tess_realloc;
-	ta.memfree = tess_free;
-	ta.userData = NULL;
-	ta.meshEdgeBucketSize = 64;
-	ta.meshVertexBucketSize = 64;
-	ta.meshFaceBucketSize = 32;
-	ta.dictNodeBucketSize = 64;
-	ta.regionBucketSize = 32;
-	ta.extraVertices = 0;
-
-	TESStesselator* t = tessNewTess(&ta);
-
-	struct vec2 points[16384];
-
-	int32_t p = 0;
-	int32_t p0 = -1;
-
-	int begun = 0;
-	ASSERT(sector->contourn > 0);
-	for (int i = 0; i < sector->contourn; i++) {
-		int ci = sector->contour0 + i;
-
-		if (p0 == -1) p0 = p;
-
-		struct lvl_contour* c = lvl_get_contour(lvl, ci);
-
-		struct lvl_linedef* l = lvl_get_linedef(lvl, c->linedef);
-		struct vec2* v = lvl_get_vertex(lvl, l->vertex[c->usr&1]);
-		AN(v);
-
-		if (LVL_CONTOUR_IS_FIRST(c)) {
-			p0 = p;
-			AZ(begun);
-			begun = 1;
-		}
-
-		memcpy(&points[p], v, sizeof(struct vec2));
-
-		if (LVL_CONTOUR_IS_LAST(c)) {
-			ASSERT(p > p0);
-			tessAddContour(t, 2, &points[p0], sizeof(struct vec2), p - p0 + 1);
-			p0 = -1;
-			AN(begun);
-			begun = 0;
-		}
-
-		p++;
-	}
-
-	int nvp = 3;
-	int tess_result = tessTesselate(t, TESS_WINDING_POSITIVE, TESS_POLYGONS, nvp, 2, NULL);
-	//int tess_result = tessTesselate(t, TESS_WINDING_ODD, TESS_POLYGONS, nvp, 2, NULL);
-	//int tess_result = tessTesselate(t, TESS_WINDING_NONZERO, TESS_POLYGONS, nvp, 2, NULL);
-	ASSERT(tess_result == 1);
-
 	render->begin_flat(render, lvl, sectori, flati);
 
-	int nverts = tessGetVertexCount(t);
-	const float* verts = tessGetVertices(t);
-	for (int i = 0; i < nverts; i++) {
+	for (int i = 0; i < mesh->n_vertices; i++) {
 		struct vec2 v;
-		v.s[0] = verts[i*2];
-		v.s[1] = verts[i*2+1];
+		v.s[0] = mesh->vertices[i*2];
+		v.s[1] = mesh->vertices[i*2+1];
 		struct vec2 uv;
 		vec2_copy(&uv, &v);
 		mat23_applyi(&flat->tx, &uv);
@@ -620,15 +615,12 @@ static void yield_flat_partial(struct render* render, struct lvl* lvl, int secto
 		);
 	}
 
-	int nelems = tessGetElementCount(t);
-	const int* elems = tessGetElements(t);
-
-	for (int i = 0; i < nelems; i++) {
-		const int* p = &elems[i * nvp];
+	for (int i = 0; i < mesh->n_triangles; i++) {
+		const int* p = &mesh->indices[i * 3];
 		uint32_t indices[3];
-		for (int j = 0; j < nvp; j++) {
+		for (int j = 0; j < 3; j++) {
 			ASSERT(p[j] != TESS_UNDEF);
-			int k = flati ? nvp - 1 - j : j;
+			int k = flati ? 2 - j : j;
 			indices[j] = p[k];
 		}
 		AN(render->add_flat_triangle);
@@ -636,22 +628,23 @@ static void yield_flat_partial(struct render* render, struct lvl* lvl, int secto
 	}
 
 	if (render->end_flat) render->end_flat(render);
-
-	tessDeleteTess(t);
 }
 
 static void yield_flats(struct render* render, struct lvl* lvl)
 {
+	flat_cache_update(&render->flat_cache, lvl);
 	for (int i = 0; i < lvl->n_sectors; i++) {
-		yield_flat_partial(render, lvl, i, 0);
-		yield_flat_partial(render, lvl, i, 1);
+		// (floor and ceiling share the tessellation)
+		struct flat_mesh mesh;
+		flat_cache_get(&render->flat_cache, i, &mesh);
+		yield_flat_partial(render, lvl, i, 0, &mesh);
+		yield_flat_partial(render, lvl, i, 1, &mesh);
 	}
 }
 
 static void render_add_type0_vertex(struct render* render, float x, float y, float z, float u, float v, float ll)
 {
-	ASSERT(render->type0_vertex_n < RENDER_BUFSZ);
-	float* data = &render->type0_vertex_data[render->type0_vertex_n * FLOATS_PER_TYPE0_VERTEX];
+	float* data = stream_push(&render->type0_vertices, 1);
 	int i = 0;
 	data[i++] = x;
 	data[i++] = y;
@@ -659,18 +652,16 @@ static void render_add_type0_vertex(struct render* render, float x, float y, flo
 	data[i++] = u;
 	data[i++] = v;
 	data[i++] = ll;
-	render->type0_vertex_n++;
 }
 
 static void render_add_type0_index(struct render* render, int32_t index)
 {
-	ASSERT(render->type0_index_n < RENDER_BUFSZ);
-	render->type0_index_data[render->type0_index_n++] = index;
+	*(int32_t*)stream_push(&render->type0_indices, 1) = index;
 }
 
 static void render_add_type0_quad(struct render* render)
 {
-	int offset = render->type0_vertex_n;
+	int offset = render->type0_vertices.n;
 	render_add_type0_index(render, offset + 0);
 	render_add_type0_index(render, offset + 1);
 	render_add_type0_index(render, offset + 2);
@@ -707,11 +698,90 @@ static void renderctx_begin_wall(struct render* render, struct lvl* lvl, int sec
 static void renderctx_add_wall_vertex(struct render* render, float x, float y, float z, float u, float v)
 {
 	if (!render->wall_enable) return;
-	ASSERT(render->type0_vertex_n < RENDER_BUFSZ);
 	struct render_texture* texture = &render->walls[render->wall_current_texture];
 	render_add_type0_vertex(render, x, y, z, u / (float)texture->width, v / (float)texture->height, render->current_light_level);
 }
 
+struct wall_quad {
+	int zd; // -1: lower, 0: one-sided, 1: upper
+	struct vec3 p[4];
+	struct vec2 uv[4];
+};
+
+// the (up to two) visible quads of a contour's sidedef
+static int wall_quads(struct lvl* lvl, int sectori, int ci, struct wall_quad* quads)
+{
+	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
+	struct lvl_contour* c = lvl_get_contour(lvl, ci);
+	struct lvl_linedef* l = lvl_get_linedef(lvl, c->linedef);
+
+	struct vec2* v0 = lvl_get_vertex(lvl, l->vertex[c->usr&1]);
+	struct vec2* v1 = lvl_get_vertex(lvl, l->vertex[(c->usr&1)^1]);
+	struct lvl_sidedef* sd = l->sidedef[c->usr&1] == -1 ? NULL : lvl_get_sidedef(lvl, l->sidedef[c->usr&1]);
+	struct lvl_sidedef* sopp = l->sidedef[(c->usr&1)^1] == -1 ? NULL : lvl_get_sidedef(lvl, l->sidedef[(c->usr&1)^1]);
+
+	AN(v0);
+	AN(v1);
+	AN(sd);
+
+	struct vec2 vd;
+	vec2_sub(&vd, v1, v0);
+
+	float vd_length = vec2_length(&vd);
+
+	int n = 0;
+	for (int zd = -1; zd <= 1; zd++) {
+		if (sopp == NULL && zd != 0) continue;
+		if (sopp != NULL && zd == 0) continue;
+
+		float u0 = 0;
+		float u1 = vd_length;
+
+		float z0,z1;
+
+		if (zd == 0) {
+			z0 = sector->flat[0].z;
+			z1 = sector->flat[1].z;
+		} else {
+			struct lvl_sector* sector1 = lvl_get_sector(lvl, sopp->sector);
+			if (zd == -1) {
+				z0 = sector->flat[0].z;
+				z1 = sector1->flat[0].z;
+				if (z1 < z0) continue;
+			} else if (zd == 1) {
+				z0 = sector1->flat[1].z;
+				z1 = sector->flat[1].z;
+				if (z0 > z1) continue;
+			} else {
+				AZ(1);
+			}
+		}
+
+		struct wall_quad* q = &quads[n++];
+		q->zd = zd;
+
+		struct vec3 p[4] = {
+			{{v0->s[0], z1, v0->s[1]}},
+			{{v1->s[0], z1, v1->s[1]}},
+			{{v1->s[0], z0, v1->s[1]}},
+			{{v0->s[0], z0, v0->s[1]}}
+		};
+		struct vec2 uv[4] = {
+			{{u0, z1}},
+			{{u1, z1}},
+			{{u1, z0}},
+			{{u0, z0}}
+		};
+
+		struct mat23* tx = &sd->tx[zd <= 0 ? 0 : 1];
+		for (int i = 0; i < 4; i++) {
+			vec3_copy(&q->p[i], &p[i]);
+			mat23_apply(tx, &q->uv[i], &uv[i]);
+		}
+	}
+	return n;
+}
+
 static void yield_walls(struct render* render, struct lvl* lvl)
 {
 	for (int sectori = 0; sectori < lvl->n_sectors; sectori++) {
@@ -720,67 +790,14 @@ static void yield_walls(struct render* render, struct lvl* lvl)
 		for (int cdi = 0; cdi < sector->contourn; cdi++) {
 			int ci = sector->contour0 + cdi;
 
-			struct lvl_contour* c = lvl_get_contour(lvl, ci);
-			struct lvl_linedef* l = lvl_get_linedef(lvl, c->linedef);
-
-			struct vec2* v0 = lvl_get_vertex(lvl, l->vertex[c->usr&1]);
-			struct vec2* v1 = lvl_get_vertex(lvl, l->vertex[(c->usr&1)^1]);
-			struct lvl_sidedef* sd = l->sidedef[c->usr&1] == -1 ? NULL : lvl_get_sidedef(lvl, l->sidedef[c->usr&1]);
-			struct lvl_sidedef* sopp = l->sidedef[(c->usr&1)^1] == -1 ? NULL : lvl_get_sidedef(lvl, l->sidedef[(c->usr&1)^1]);
-
-			AN(v0);
-			AN(v1);
-			AN(sd);
-
-			struct vec2 vd;
-			vec2_sub(&vd, v1, v0);
-
-			float vd_length = vec2_length(&vd);
-
-			for (int zd = -1; zd <= 1; zd++) {
-				if (sopp == NULL && zd != 0) continue;
-				if (sopp != NULL && zd == 0) continue;
-
-				float u0 = 0;
-				float u1 = vd_length;
-
-				float z0,z1;
-
-				if (zd == 0) {
-					z0 = sector->flat[0].z;
-					z1 = sector->flat[1].z;
-				} else {
-					struct lvl_sector* sector1 = lvl_get_sector(lvl, sopp->sector);
-					if (zd == -1) {
-						z0 = sector->flat[0].z;
-						z1 = sector1->flat[0].z;
-						if (z1 < z0) continue;
-					} else if (zd == 1) {
-						z0 = sector1->flat[1].z;
-						z1 = sector->flat[1].z;
-						if (z0 > z1) continue;
-					} else {
-						AZ(1);
-					}
+			struct wall_quad quads[2];
+			int n = wall_quads(lvl, sectori, ci, quads);
+			for (int i = 0; i < n; i++) {
+				struct wall_quad* q = &quads[i];
+				render->begin_wall(render, lvl, sectori, ci, q->zd);
+				for (int j = 0; j < 4; j++) {
+					render->add_wall_vertex(render, q->p[j].s[0], q->p[j].s[1], q->p[j].s[2], q->uv[j].s[0], q->uv[j].s[1]);
 				}
-
-				struct vec2 uv[4] = {
-					{{u0, z1}},
-					{{u1, z1}},
-					{{u1, z0}},
-					{{u0, z0}}
-				};
-
-				struct mat23* tx = &sd->tx[zd <= 0 ? 0 : 1];
-				for (int uvi = 0; uvi < 4; uvi++) {
-					mat23_applyi(tx, &uv[uvi]);
-				}
-
-				render->begin_wall(render, lvl, sectori, ci, zd);
-				render->add_wall_vertex(render, v0->s[0], z1, v0->s[1], uv[0].s[0], uv[0].s[1]);
-				render->add_wall_vertex(render, v1->s[0], z1, v1->s[1], uv[1].s[0], uv[1].s[1]);
-				render->add_wall_vertex(render, v1->s[0], z0, v1->s[1], uv[2].s[0], uv[2].s[1]);
-				render->add_wall_vertex(render, v0->s[0], z0, v0->s[1], uv[3].s[0], uv[3].s[1]);
 				if (render->end_wall) render->end_wall(render);
 			}
 		}
@@ -852,21 +869,22 @@ static void wall_callbacks(
 
 static void flush_type0_data(struct render* render)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, render->type0_vertex_buffer); CHKGL;
-	glBufferSubData(GL_ARRAY_BUFFER, 0, render->type0_vertex_n * sizeof(float) * FLOATS_PER_TYPE0_VERTEX, render->type0_vertex_data); CHKGL;
+	stream_upload(&render->type0_vertices);
 
 	glVertexAttribPointer(render->type0_a_pos, 3, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_TYPE0_VERTEX, 0); CHKGL;
 	glVertexAttribPointer(render->type0_a_uv, 2, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_TYPE0_VERTEX, (char*)(sizeof(float)*3)); CHKGL;
 	glVertexAttribPointer(render->type0_a_light_level, 1, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_TYPE0_VERTEX, (char*)(sizeof(float)*5)); CHKGL;
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render->type0_index_buffer); CHKGL;
-	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, render->type0_index_n * sizeof(int32_t), render->type0_index_data); CHKGL;
-	glDrawElements(GL_TRIANGLES, render->type0_vertex_n/4*6, GL_UNSIGNED_INT, NULL); CHKGL;
+	stream_upload(&render->type0_indices);
+	glDrawElements(GL_TRIANGLES, render->type0_indices.n, GL_UNSIGNED_INT, NULL); CHKGL;
+	STATS_ADD(draw_calls, 1);
 }
 
 
 static void render_walls(struct render* render, struct lvl* lvl)
 {
+	PROF_ZONE("walls");
+
 	wall_callbacks(render, renderctx_begin_wall, renderctx_add_wall_vertex, NULL);
 
 	render->wall_next_texture = -1;
@@ -881,8 +899,8 @@ static void render_walls(struct render* render, struct lvl* lvl)
 	glEnableVertexAttribArray(render->type0_a_light_level); CHKGL;
 
 	do {
-		render->type0_vertex_n = 0;
-		render->type0_index_n = 0;
+		stream_reset(&render->type0_vertices);
+		stream_reset(&render->type0_indices);
 		render->wall_current_texture = render->wall_next_texture;
 		render->wall_next_texture = -1;
 
@@ -891,6 +909,7 @@ static void render_walls(struct render* render, struct lvl* lvl)
 		if (render->wall_current_texture == -1) continue;
 
 		glBindTexture(GL_TEXTURE_2D, render->walls[render->wall_current_texture].texture); CHKGL;
+		STATS_ADD(texture_binds, 1);
 
 		flush_type0_data(render);
 	} while (render->wall_next_texture != -1);
@@ -924,10 +943,12 @@ static void render_step(struct render* render)
 	glActiveTexture(GL_TEXTURE0); CHKGL;
 	glEnable(GL_TEXTURE_2D); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, render->screen_texture); CHKGL;
+	STATS_ADD(texture_binds, 1);
 
 	glActiveTexture(GL_TEXTURE1); CHKGL;
 	glEnable(GL_TEXTURE_2D); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, render->palette_lookup_texture); CHKGL;
+	STATS_ADD(texture_binds, 1);
 
 	glBindBuffer(GL_ARRAY_BUFFER, render->step_vertex_buffer); CHKGL;
 
@@ -936,6 +957,7 @@ static void render_step(struct render* render)
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render->step_index_buffer); CHKGL;
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, NULL); CHKGL;
+	STATS_ADD(draw_calls, 1);
 
 	glDisableVertexAttribArray(render->step_a_pos); CHKGL;
 
@@ -972,6 +994,7 @@ static void render_blit(struct render* render)
 	glActiveTexture(GL_TEXTURE0); CHKGL;
 	glEnable(GL_TEXTURE_2D); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, render->step_texture);
+	STATS_ADD(texture_binds, 1);
 
 	glColor4f(1,1,1,1);
 	glBegin(GL_QUADS);
@@ -980,12 +1003,14 @@ static void render_blit(struct render* render)
 	glMultiTexCoord2f(GL_TEXTURE0, 1, 1); glVertex2f(1,1);
 	glMultiTexCoord2f(GL_TEXTURE0, 0, 1); glVertex2f(0,1);
 	glEnd();
-
+	STATS_ADD(draw_calls, 1);
 }
 static void render_flats(struct render* render, struct lvl* lvl)
 {
-	render->flat_vertex_n = 0;
-	render->flat_index_n = 0;
+	PROF_ZONE("flats");
+
+	stream_reset(&render->flat_vertices);
+	stream_reset(&render->flat_indices);
 	flat_callbacks(
 		render,
 		renderctx_begin_flat,
@@ -995,16 +1020,16 @@ static void render_flats(struct render* render, struct lvl* lvl)
 	);
 	yield_flats(render, lvl);
 
-	AZ(render->flat_index_n % 3); // threeangles!
+	AZ(render->flat_indices.n % 3); // threeangles!
 
 	shader_use(&render->flat_shader);
 
 	glActiveTexture(GL_TEXTURE0); CHKGL;
 	glEnable(GL_TEXTURE_2D); CHKGL;
 	glBindTexture(GL_TEXTURE_2D, render->flatlas_texture); CHKGL;
+	STATS_ADD(texture_binds, 1);
 
-	glBindBuffer(GL_ARRAY_BUFFER, render->flat_vertex_buffer); CHKGL;
-	glBufferSubData(GL_ARRAY_BUFFER, 0, render->flat_vertex_n * sizeof(float) * FLOATS_PER_FLAT_VERTEX, render->flat_vertex_data); CHKGL;
+	stream_upload(&render->flat_vertices);
 
 	glEnableVertexAttribArray(render->flat_a_pos); CHKGL;
 	glVertexAttribPointer(render->flat_a_pos, 3, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_FLAT_VERTEX, 0); CHKGL;
@@ -1018,10 +1043,10 @@ static void render_flats(struct render* render, struct lvl* lvl)
 	glEnableVertexAttribArray(render->flat_a_light_level); CHKGL;
 	glVertexAttribPointer(render->flat_a_light_level, 1, GL_FLOAT, GL_FALSE, sizeof(float) * FLOATS_PER_FLAT_VERTEX, (char*)(sizeof(float)*7)); CHKGL;
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render->flat_index_buffer); CHKGL;
-	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, render->flat_index_n * sizeof(uint32_t), render->flat_index_data); CHKGL;
+	stream_upload(&render->flat_indices);
 
-	glDrawElements(GL_TRIANGLES, render->flat_index_n, GL_UNSIGNED_INT, NULL); CHKGL;
+	glDrawElements(GL_TRIANGLES, render->flat_indices.n, GL_UNSIGNED_INT, NULL); CHKGL;
+	STATS_ADD(draw_calls, 1);
 
 	glDisableVertexAttribArray(render->flat_a_light_level); CHKGL;
 	glDisableVertexAttribArray(render->flat_a_selector); CHKGL;
@@ -1071,8 +1096,10 @@ static void render_lvl_geom(struct render* render, struct lvl* lvl)
 	render_walls(render, lvl);
 }
 
-static void render_lvl_entities(struct render* render, struct lvl* lvl)
+static void render_lvl_entities(struct render* render, struct lvl* lvl, struct lvl_entity* entities, int n_entities)
 {
+	PROF_ZONE("entities");
+
 	shader_use(&render->type0_shader);
 
 	glActiveTexture(GL_TEXTURE0); CHKGL;
@@ -1086,17 +1113,18 @@ static void render_lvl_entities(struct render* render, struct lvl* lvl)
 	int current_texture;
 
 	// (FIXME maybe sprites ought to be atlas based?)
-	int nomnom_type = names_find_entity_type("nomnom");
 	do {
-		render->type0_vertex_n = 0;
-		render->type0_index_n = 0;
+		stream_reset(&render->type0_vertices);
+		stream_reset(&render->type0_indices);
 		current_texture = next_texture;
 		next_texture = -1;
-		for (int i = 0; i < lvl->n_entities; i++) {
-			struct lvl_entity* e = lvl_get_entity(lvl, i);
-			if (e->type == ENTITY_DELETED || e->type == nomnom_type) continue;
+		for (int i = 0; i < n_entities; i++) {
+			struct lvl_entity* e = &entities[i];
+			if (e->type == ENTITY_DELETED) continue;
+			const struct lvl_entity_type* type = lvl_entity_type(e);
+			if (type->draw != ENTITY_DRAW_SPRITE) continue;
 
-			int texture = 0; // XXX TODO FIXME who knows this?
+			int texture = type->art;
 
 			if (texture == current_texture) {
 				struct lvl_sector* sector = lvl_get_sector(lvl, e->sector);
@@ -1110,7 +1138,7 @@ static void render_lvl_entities(struct render* render, struct lvl* lvl)
 				vec2_normal(&ivn, &iv);
 				vec2_normalize(&ivn);
 				vec2_scalei(&ivn, (float)t->width / 2.0);
-				float z0 = e->z + MAGIC_EVEN_MORE_MAGIC_ENTITY_HEIGHT;
+				float z0 = e->z + type->height;
 				float z1 = z0 - (float)t->height;
 
 				struct vec2 p0;
@@ -1167,8 +1195,9 @@ static void render_lvl_entities(struct render* render, struct lvl* lvl)
 		if (current_texture == -1) continue;
 
 		glBindTexture(GL_TEXTURE_2D, render->sprites[current_texture].texture); CHKGL;
+		STATS_ADD(texture_binds, 1);
 
-		//printf("spr: %d\n", render->type0_vertex_n);
+		//printf("spr: %d\n", render->type0_vertices.n);
 
 		flush_type0_data(render);
 	} while (next_texture != -1);
@@ -1181,8 +1210,10 @@ static void render_lvl_entities(struct render* render, struct lvl* lvl)
 	glDisable(GL_TEXTURE_2D); CHKGL;
 }
 
-static void render_lvl_nomnom(struct render* render, struct lvl* lvl)
+static void render_lvl_nomnom(struct render* render, struct lvl* lvl, struct lvl_entity* entities, int n_entities)
 {
+	PROF_ZONE("nomnom");
+
 	shader_use(&render->type0_shader);
 
 	glActiveTexture(GL_TEXTURE0); CHKGL;
@@ -1195,21 +1226,24 @@ static void render_lvl_nomnom(struct render* render, struct lvl* lvl)
 	glEnableVertexAttribArray(render->type0_a_light_level); CHKGL;
 
 	glBindTexture(GL_TEXTURE_2D, render->nomnom_texture.texture); CHKGL;
-
-	int nomnom_type = names_find_entity_type("nomnom");
-	for (int i = 0; i < lvl->n_entities; i++) {
-		struct lvl_entity* e = lvl_get_entity(lvl, i);
-		if (e->type != nomnom_type) continue;
+	STATS_ADD(texture_binds, 1);
+
+	for (int i = 0; i < n_entities; i++) {
+		struct lvl_entity* e = &entities[i];
+		if (e->type == ENTITY_DELETED) continue;
+		const struct lvl_entity_type* type = lvl_entity_type(e);
+		// (the nomnom is the only mesh there is)
+		if (type->draw != ENTITY_DRAW_MESH) continue;
 		struct lvl_sector* sector = lvl_get_sector(lvl, e->sector);
 		float ll = sector->light_level;
 
 		glMatrixMode(GL_MODELVIEW); CHKGL;
 		glPushMatrix();
-		glTranslatef(e->position.s[0], e->z - MAGIC_EVEN_MORE_MAGIC_ENTITY_HEIGHT, e->position.s[1]);
+		glTranslatef(e->position.s[0], e->z - type->height, e->position.s[1]);
 		glRotatef(-e->yaw+180, 0, 1, 0);
 
-		render->type0_vertex_n = 0;
-		render->type0_index_n = 0;
+		stream_reset(&render->type0_vertices);
+		stream_reset(&render->type0_indices);
 
 		for (int j = 0; j < render->nomnom_msh.n_vertices; j++) {
 			render_add_type0_vertex(
@@ -1244,6 +1278,19 @@ static void render_lvl_nomnom(struct render* render, struct lvl* lvl)
 
 void render_lvl(struct render* render, struct lvl* lvl)
 {
+	struct lvl_entity* entities = frame_alloc(lvl->n_entities * sizeof(*entities));
+	for (int i = 0; i < lvl->n_entities; i++) {
+		lvl_entity_lerp(&entities[i], lvl_get_entity(lvl, i), render->alpha);
+	}
+	render_lvl_with_entities(render, lvl, entities, lvl->n_entities);
+}
+
+void render_lvl_with_entities(struct render* render, struct lvl* lvl, struct lvl_entity* entities, int n_entities)
+{
+	PROF_ZONE("render_lvl");
+
+	gpu_timer_begin_frame(&render->gpu);
+
 	gl_transform(render);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, render->screen_framebuffer); CHKGL;
@@ -1255,107 +1302,142 @@ void render_lvl(struct render* render, struct lvl* lvl)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); CHKGL;
 	glEnable(GL_DEPTH_TEST);
 
+	gpu_timer_begin(&render->gpu, GPU_GEOM);
 	render_lvl_geom(render, lvl);
-	render_lvl_entities(render, lvl);
-	render_lvl_nomnom(render, lvl);
+	gpu_timer_end(&render->gpu, GPU_GEOM);
+
+	gpu_timer_begin(&render->gpu, GPU_ENTITIES);
+	render_lvl_entities(render, lvl, entities, n_entities);
+	render_lvl_nomnom(render, lvl, entities, n_entities);
+	gpu_timer_end(&render->gpu, GPU_ENTITIES);
 }
 
 void render_flip(struct render* render)
 {
+	PROF_ZONE("render_flip");
+
+	gpu_timer_begin(&render->gpu, GPU_STEP);
 	render_step(render);
+	gpu_timer_end(&render->gpu, GPU_STEP);
+
+	gpu_timer_begin(&render->gpu, GPU_BLIT);
 	render_blit(render);
+	gpu_timer_end(&render->gpu, GPU_BLIT);
 
 	glUseProgram(0); CHKGL;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+
+	frame_flip();
 }
 
-static void tagsctx_gl_color(int hover, int selected)
+static int overlay_color(int hover, int selected, float* rgba)
 {
 	if (selected) {
-		glColor4f(1,1,0,0.3);
+		rgba[0] = 1; rgba[1] = 1; rgba[2] = 0; rgba[3] = 0.3;
 	} else if (hover) {
-		glColor4f(1,1,1,0.1);
-	} else {
-		glColor4f(1,1,1,0);
-	}
-}
-
-static void tagsctx_begin_flat(struct render* render, struct lvl* lvl, int sectori, int flati)
-{
-	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
-	int hover = ((flati == 0 && (sector->usr & LVL_HIGHLIGHTED_ZMINUS)) || (flati == 1 && (sector->usr & LVL_HIGHLIGHTED_ZPLUS)));
-	int selected = ((flati == 0 && (sector->usr & LVL_SELECTED_ZMINUS)) || (flati == 1 && (sector->usr & LVL_SELECTED_ZPLUS)));
-	if (hover || selected) {
-		render->tags_flat_vertex_n = 0;
-		render->tags_flat_index_n = 0;
-		tagsctx_gl_color(hover, selected);
+		rgba[0] = 1; rgba[1] = 1; rgba[2] = 1; rgba[3] = 0.1;
 	} else {
-		render->tags_flat_vertex_n = -1;
-		render->tags_flat_index_n = -1;
+		return 0;
 	}
+	return 1;
 }
 
-static void tagsctx_add_flat_vertex(struct render* render, float x, float y, float z, float u, float v)
+static void overlay_add_vertex(struct render* render, float x, float y, float z, float* rgba)
 {
-	if (render->tags_flat_vertex_n < 0) return;
-	struct vec3 p;
-	p.s[0] = x;
-	p.s[1] = y;
-	p.s[2] = z;
-	vec3_copy(&render->tags_flat_vertices[render->tags_flat_vertex_n++], &p);
-
+	float* data = stream_push(&render->overlay_vertices, 1);
+	data[0] = x;
+	data[1] = y;
+	data[2] = z;
+	for (int i = 0; i < 4; i++) data[3+i] = rgba[i];
 }
 
-static void tagsctx_add_flat_triangle(struct render* render, uint32_t indices[3])
+static void overlay_add_flat(struct render* render, struct lvl* lvl, int sectori, int flati, float* rgba)
 {
-	if (render->tags_flat_index_n < 0) return;
-	for (int i = 0; i < 3; i++) {
-		render->tags_flat_indices[render->tags_flat_index_n++] = indices[i];
+	struct flat_mesh mesh;
+	flat_cache_get(&render->flat_cache, sectori, &mesh);
+	float z = lvl_get_sector(lvl, sectori)->flat[flati].z;
+	for (int i = 0; i < mesh.n_triangles; i++) {
+		const int* p = &mesh.indices[i * 3];
+		for (int j = 0; j < 3; j++) {
+			// (same winding as yield_flat_partial())
+			int k = p[flati ? 2 - j : j];
+			overlay_add_vertex(render, mesh.vertices[k*2], z, mesh.vertices[k*2+1], rgba);
+		}
 	}
 }
 
-static void tagsctx_end_flat(struct render* render)
+static void overlay_add_sidedef(struct render* render, struct lvl* lvl, int32_t sdi, uint32_t tags)
 {
-	if (render->tags_flat_index_n < 0) return;
-	glBegin(GL_TRIANGLES);
-	for (int i = 0; i < render->tags_flat_index_n; i++) {
-		struct vec3* v = &render->tags_flat_vertices[render->tags_flat_indices[i]];
-		glVertex3f(v->s[0], v->s[1], v->s[2]);
+	int sectori = lvl_get_sidedef(lvl, sdi)->sector;
+	struct lvl_sector* sector = lvl_get_sector(lvl, sectori);
+	for (int cdi = 0; cdi < sector->contourn; cdi++) {
+		int ci = sector->contour0 + cdi;
+		struct lvl_contour* c = lvl_get_contour(lvl, ci);
+		if (lvl_get_linedef(lvl, c->linedef)->sidedef[c->usr&1] != sdi) continue;
+
+		struct wall_quad quads[2];
+		int n = wall_quads(lvl, sectori, ci, quads);
+		for (int i = 0; i < n; i++) {
+			struct wall_quad* q = &quads[i];
+			int dz = q->zd;
+			int hover = (dz <= 0 && (tags & LVL_HIGHLIGHTED_ZMINUS)) || (dz >= 0 && (tags & LVL_HIGHLIGHTED_ZPLUS));
+			int selected = (dz <= 0 && (tags & LVL_SELECTED_ZMINUS)) || (dz >= 0 && (tags & LVL_SELECTED_ZPLUS));
+			float rgba[4];
+			if (!overlay_color(hover, selected, rgba)) continue;
+			static const int quad[6] = {0, 1, 2, 0, 2, 3};
+			for (int j = 0; j < 6; j++) {
+				struct vec3* v = &q->p[quad[j]];
+				overlay_add_vertex(render, v->s[0], v->s[1], v->s[2], rgba);
+			}
+		}
 	}
-	glEnd();
 }
 
-static void tagsctx_begin_wall(struct render* render, struct lvl* lvl, int sectori, int contouri, int dz)
+/* the overlay only covers tagged elements, so it's built by walking the tag
+ * sets, and only when they (or anything they cover) went dirty */
+static void overlay_update(struct render* render, struct lvl* lvl)
 {
-	struct lvl_contour* c = lvl_get_contour(lvl, contouri);
-	struct lvl_linedef* ld = lvl_get_linedef(lvl, c->linedef);
-	struct lvl_sidedef* sd = lvl_get_sidedef(lvl, ld->sidedef[c->usr&1]);
-
-	int hover = (dz <= 0 && (sd->usr & LVL_HIGHLIGHTED_ZMINUS)) || (dz >= 0 && (sd->usr & LVL_HIGHLIGHTED_ZPLUS));
-	int selected = (dz <= 0 && (sd->usr & LVL_SELECTED_ZMINUS)) || (dz >= 0 && (sd->usr & LVL_SELECTED_ZPLUS));
-
-	tagsctx_gl_color(hover, selected);
-	glBegin(GL_QUADS);
-}
+	struct lvl_tags* tags = &lvl->tags;
+	int dirty = tags->dirty_sectors.n > 0 || tags->dirty_sidedefs.n > 0;
+	if (render->overlay_valid && render->overlay_generation == lvl->generation && !dirty) return;
+
+	stream_reset(&render->overlay_vertices);
+
+	for (int i = 0; i < tags->sectors.n; i++) {
+		int32_t sectori = tags->sectors.ids[i];
+		uint32_t t = tags->sectors.flags[i];
+		for (int flati = 0; flati < 2; flati++) {
+			int hover = t & (flati == 0 ? LVL_HIGHLIGHTED_ZMINUS : LVL_HIGHLIGHTED_ZPLUS);
+			int selected = t & (flati == 0 ? LVL_SELECTED_ZMINUS : LVL_SELECTED_ZPLUS);
+			float rgba[4];
+			if (!overlay_color(hover, selected, rgba)) continue;
+			overlay_add_flat(render, lvl, sectori, flati, rgba);
+		}
+	}
 
-static void tagsctx_add_wall_vertex(struct render* render, float x, float y, float z, float u, float v)
-{
-	glVertex3f(x,y,z);
-}
+	for (int i = 0; i < tags->sidedefs.n; i++) {
+		overlay_add_sidedef(render, lvl, tags->sidedefs.ids[i], tags->sidedefs.flags[i]);
+	}
 
-static void tagsctx_end_wall(struct render* render)
-{
-	glEnd();
+	stream_upload(&render->overlay_vertices);
+	lvl_tag_clear_dirty(lvl);
+	render->overlay_valid = 1;
+	render->overlay_generation = lvl->generation;
 }
 
 void render_lvl_tags(struct render* render, struct lvl* lvl)
 {
+	flat_cache_update(&render->flat_cache, lvl);
+	overlay_update(render, lvl);
+
 	gl_transform(render);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
 	gl_viewport_from_sdl_window(render->window);
 	glClear(GL_DEPTH_BUFFER_BIT);
 
+	if (render->overlay_vertices.n == 0) return;
+
 	glUseProgram(0);
 	glActiveTexture(GL_TEXTURE0); CHKGL;
 	glDisable(GL_TEXTURE_2D); CHKGL;
@@ -1364,21 +1446,17 @@ void render_lvl_tags(struct render* render, struct lvl* lvl)
 	glEnable(GL_BLEND);
 	glDisable(GL_DEPTH_TEST);
 
-	flat_callbacks(
-		render,
-		tagsctx_begin_flat,
-		tagsctx_add_flat_vertex,
-		tagsctx_add_flat_triangle,
-		tagsctx_end_flat
-	);
-	yield_flats(render, lvl);
+	glBindBuffer(GL_ARRAY_BUFFER, render->overlay_vertices.buffer); CHKGL;
+	glEnableClientState(GL_VERTEX_ARRAY); CHKGL;
+	glEnableClientState(GL_COLOR_ARRAY); CHKGL;
+	glVertexPointer(3, GL_FLOAT, sizeof(float) * FLOATS_PER_OVERLAY_VERTEX, 0); CHKGL;
+	glColorPointer(4, GL_FLOAT, sizeof(float) * FLOATS_PER_OVERLAY_VERTEX, (char*)(sizeof(float)*3)); CHKGL;
 
-	wall_callbacks(
-		render,
-		tagsctx_begin_wall,
-		tagsctx_add_wall_vertex,
-		tagsctx_end_wall
-	);
-	yield_walls(render, lvl);
+	glDrawArrays(GL_TRIANGLES, 0, render->overlay_vertices.n); CHKGL;
+	STATS_ADD(draw_calls, 1);
+
+	glDisableClientState(GL_COLOR_ARRAY); CHKGL;
+	glDisableClientState(GL_VERTEX_ARRAY); CHKGL;
+	glBindBuffer(GL_ARRAY_BUFFER, 0); CHKGL;
 }
 
@@ -6,6 +6,10 @@
 #include "shader.h"
 #include "lvl.h"
 #include "mud.h"
+#include "watch.h"
+#include "flat.h"
+#include "stream.h"
+#include "gpu.h"
 
 #define MAX_WALLS (1024)
 #define MAX_SPRITES (4096)
@@ -29,29 +33,24 @@ struct render {
 	GLuint step_vertex_buffer;
 	GLuint step_index_buffer;
 
-	GLuint flat_vertex_buffer;
-	GLuint flat_index_buffer;
-	float* flat_vertex_data;
-	int32_t* flat_index_data;
-	int flat_vertex_n;
-	int flat_offset;;
-	int flat_index_n;
+	struct stream flat_vertices;
+	struct stream flat_indices;
+	int flat_offset;
 	float current_select_u, current_select_v, current_light_level;
 
+	struct flat_cache flat_cache;
+
 	struct render_texture walls[MAX_WALLS];
 	struct render_texture sprites[MAX_SPRITES];
 
-	GLuint type0_vertex_buffer;
-	GLuint type0_index_buffer;
-	float* type0_vertex_data;
-	int32_t* type0_index_data;
-	int type0_vertex_n;
-	int type0_index_n;
+	struct stream type0_vertices;
+	struct stream type0_indices;
 
 	int wall_current_texture, wall_next_texture;
 	int wall_enable;
 
 	struct lvl_entity* entity_cam;
+	float alpha; // entities are drawn this far into the current tick
 
 	GLuint palette_lookup_texture;
 	GLuint flatlas_texture;
@@ -101,22 +100,38 @@ struct render {
 	);
 	void (*end_wall)(struct render* render);
 
-	struct vec3* tags_flat_vertices;
-	int tags_flat_vertex_n;
-	int* tags_flat_indices;
-	int tags_flat_index_n;
+	// editor tag overlay (see render_lvl_tags())
+	int overlay_valid;
+	uint32_t overlay_generation; // of the level it was built for
+	struct stream overlay_vertices;
 
 	struct msh nomnom_msh;
 	struct render_texture nomnom_texture;
+
+	struct gpu_timer gpu;
 };
 
 
 void render_init(struct render* render, SDL_Window* window);
 float render_get_fovy(struct render* render);
 void render_set_entity_cam(struct render* render, struct lvl_entity* entity);
+void render_set_alpha(struct render* render, float alpha);
 void render_lvl(struct render* render, struct lvl* lvl);
+/* like render_lvl(), but with these (already interpolated) entities instead
+ * of lvl's, so it only reads lvl's geometry */
+void render_lvl_with_entities(struct render* render, struct lvl* lvl, struct lvl_entity* entities, int n_entities);
 void render_begin2d(struct render* render);
 void render_flip(struct render* render);
 void render_lvl_tags(struct render* render, struct lvl* lvl);
 
+// streaming buffer high-water marks and GPU pass times, to stdout
+void render_print_stats(struct render* render);
+
+/* takes over a flat cache built elsewhere (see loader.h), instead of
+ * tessellating its level on first sight; fc is left empty */
+void render_adopt_flats(struct render* render, struct flat_cache* fc);
+
+// apply a hot reloaded asset (see watch.h)
+void render_reload(struct render* render, struct watch_asset* asset);
+
 #endif/*RENDER_H*/
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "rthread.h"
+#include "prof.h"
+#include "a.h"
+
+static int rthread_run(void* usr)
+{
+	struct rthread* rt = usr;
+	SAZ(SDL_GL_MakeCurrent(rt->window, rt->glctx));
+	PROF_THREAD_BEGIN("render");
+	for (;;) {
+		SAZ(SDL_SemWait(rt->submitted));
+		if (rt->exiting) break;
+		rt->draw(rt->usr, rt->packet);
+		SAZ(SDL_SemPost(rt->drawn));
+	}
+	PROF_THREAD_END();
+	SAZ(SDL_GL_MakeCurrent(rt->window, NULL));
+	return 0;
+}
+
+void rthread_start(struct rthread* rt, SDL_Window* window, SDL_GLContext glctx, void (*draw)(void* usr, void* packet), void* usr)
+{
+	memset(rt, 0, sizeof(*rt));
+	rt->window = window;
+	rt->glctx = glctx;
+	rt->draw = draw;
+	rt->usr = usr;
+
+	rt->submitted = SDL_CreateSemaphore(0);
+	SAN(rt->submitted);
+	rt->drawn = SDL_CreateSemaphore(1); // (nothing in flight)
+	SAN(rt->drawn);
+
+	SAZ(SDL_GL_MakeCurrent(window, NULL));
+	rt->thread = SDL_CreateThread(rthread_run, "render", rt);
+	SAN(rt->thread);
+}
+
+void* rthread_submit(struct rthread* rt, void* packet, const char* trace_path)
+{
+	void* prev;
+	{
+		PROF_ZONE("rthread_wait");
+		SAZ(SDL_SemWait(rt->drawn));
+	}
+	if (trace_path) prof_dump(trace_path);
+	prev = rt->packet;
+	rt->packet = packet;
+	SAZ(SDL_SemPost(rt->submitted));
+	return prev;
+}
+
+void* rthread_stop(struct rthread* rt)
+{
+	SAZ(SDL_SemWait(rt->drawn));
+	void* prev = rt->packet;
+	rt->packet = NULL;
+	rt->exiting = 1;
+	SAZ(SDL_SemPost(rt->submitted));
+	SDL_WaitThread(rt->thread, NULL);
+
+	SDL_DestroySemaphore(rt->submitted);
+	SDL_DestroySemaphore(rt->drawn);
+
+	SAZ(SDL_GL_MakeCurrent(rt->window, rt->glctx));
+	return prev;
+}
@@ -0,0 +1,37 @@
+#ifndef RTHREAD_H
+#define RTHREAD_H
+
+#include <SDL.h>
+
+/* render thread. it owns the GL context, and draws (and swaps) the frame
+ * packets the main thread records, so one frame is drawn while the next
+ * one is simulated and recorded. packets are opaque here; draw() is called
+ * on the render thread with the context current */
+
+struct rthread {
+	SDL_Window* window;
+	SDL_GLContext glctx;
+	void (*draw)(void* usr, void* packet);
+	void* usr;
+
+	SDL_Thread* thread;
+	SDL_sem* submitted;
+	SDL_sem* drawn;
+	void* packet; // the last one submitted
+	int exiting;
+};
+
+// glctx must be current on the calling thread; it's handed over
+void rthread_start(struct rthread* rt, SDL_Window* window, SDL_GLContext glctx, void (*draw)(void* usr, void* packet), void* usr);
+
+/* waits for the previous packet to be drawn, and returns it (NULL the
+ * first time), so the caller knows when it's done with it. if trace_path
+ * isn't NULL, the trace is dumped there (see prof_dump()) in between, while
+ * the render thread is idle */
+void* rthread_submit(struct rthread* rt, void* packet, const char* trace_path);
+
+/* waits for the last packet (returned, or NULL), stops the thread and
+ * makes glctx current on the calling thread again */
+void* rthread_stop(struct rthread* rt);
+
+#endif/*RTHREAD_H*/
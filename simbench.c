@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "a.h"
+#include "lvl.h"
+#include "llvl.h"
+#include "names.h"
+#include "lvlb.h"
+#include "tick.h"
+
+/* headless simulation benchmark: spawns wandering entities in a level and
+ * steps them without a window. the level, the spawns and their wandering
+ * only depend on the arguments, so the checksum changes only when the
+ * simulation's behaviour does */
+
+static void usage(char* argv0)
+{
+	fprintf(stderr, "usage: %s [-s <seed>] [-n <entities>] [-t <ticks>] [-c] <plan|level.lvlb>\n", argv0);
+	fprintf(stderr, "  -s    plan and spawn seed (default 1)\n");
+	fprintf(stderr, "  -n    number of entities to spawn (default 64)\n");
+	fprintf(stderr, "  -t    number of ticks to run (default 600)\n");
+	fprintf(stderr, "  -c    print a checksum of the final entity positions\n");
+	exit(EXIT_FAILURE);
+}
+
+// Park-Miller, like the plan builder
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+	rng_state = (uint64_t)rng_state * 16807 % 2147483647;
+	return rng_state;
+}
+
+static float rng_float(float lo, float hi)
+{
+	return lo + (hi - lo) * ((float)(rng_next() % 1000000) / 1000000.0f);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	AZ(clock_gettime(CLOCK_MONOTONIC, &ts));
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bounds(struct lvl* lvl, struct vec2* min, struct vec2* max)
+{
+	for (int i = 0; i < lvl->n_vertices; i++) {
+		struct vec2* v = lvl_get_vertex(lvl, i);
+		for (int j = 0; j < 2; j++) {
+			if (i == 0 || v->s[j] < min->s[j]) min->s[j] = v->s[j];
+			if (i == 0 || v->s[j] > max->s[j]) max->s[j] = v->s[j];
+		}
+	}
+}
+
+static void spawn(struct lvl* lvl, int n)
+{
+	int type = names_find_entity_type("nightmare");
+	struct vec2 min, max;
+	bounds(lvl, &min, &max);
+
+	for (int i = 0; i < n; i++) {
+		struct vec2 p;
+		int tries = 0;
+		do {
+			if (++tries > 10000) arghf("could not find a spot inside the level to spawn at");
+			p.s[0] = rng_float(min.s[0], max.s[0]);
+			p.s[1] = rng_float(min.s[1], max.s[1]);
+		} while (lvl_sector_find(lvl, &p) == -1);
+
+		struct lvl_entity* e = lvl_get_entity(lvl, lvl_new_entity(lvl));
+		e->type = type;
+		vec2_copy(&e->position, &p);
+		e->yaw = rng_float(0, 360);
+		vec2_angle(&e->velocity, e->yaw);
+		vec2_scalei(&e->velocity, rng_float(0, 400));
+		lvl_entity_update_sector(lvl, e);
+	}
+}
+
+static void wander(struct lvl* lvl)
+{
+	float dt = TICK_DT;
+	for (int i = 0; i < lvl->n_entities; i++) {
+		struct lvl_entity* e = lvl_get_entity(lvl, i);
+		if (e->type == ENTITY_DELETED) continue;
+		lvl_entity_begin_tick(e);
+		if (rng_next() % TICK_HZ == 0) e->yaw = rng_float(0, 360);
+		struct vec2 accel;
+		vec2_angle(&accel, e->yaw);
+		lvl_entity_accelerate(lvl, e, &accel, dt);
+		lvl_entity_clipmove(lvl, e, dt);
+	}
+}
+
+static uint64_t checksum(struct lvl* lvl)
+{
+	uint64_t hash = 0;
+	for (int i = 0; i < lvl->n_entities; i++) {
+		struct lvl_entity* e = lvl_get_entity(lvl, i);
+		hash = lvlb_hash(hash, &e->position, sizeof(e->position));
+		hash = lvlb_hash(hash, &e->z, sizeof(e->z));
+		hash = lvlb_hash(hash, &e->sector, sizeof(e->sector));
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+	int n_entities = 64;
+	int n_ticks = 600;
+	int print_checksum = 0;
+
+	int argi = 1;
+	for (; argi < argc && argv[argi][0] == '-'; argi++) {
+		if (strcmp(argv[argi], "-s") == 0 && argi+1 < argc) {
+			seed = strtoul(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "-n") == 0 && argi+1 < argc) {
+			n_entities = atoi(argv[++argi]);
+		} else if (strcmp(argv[argi], "-t") == 0 && argi+1 < argc) {
+			n_ticks = atoi(argv[++argi]);
+		} else if (strcmp(argv[argi], "-c") == 0) {
+			print_checksum = 1;
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (argi != argc-1 || n_entities < 0 || n_ticks <= 0) usage(argv[0]);
+	char* plan = argv[argi];
+
+	struct lvl lvl;
+	size_t plan_len = strlen(plan);
+	if (plan_len > 5 && strcmp(plan + plan_len - 5, ".lvlb") == 0) {
+		if (lvlb_load(plan, &lvl) == -1) arghf("%s: missing or invalid compiled level", plan);
+	} else {
+		lvl_init(&lvl);
+		llvl_build(plan, seed, &lvl);
+	}
+
+	rng_state = seed % 2147483646 + 1;
+	spawn(&lvl, n_entities);
+
+	printf("%s: %u sectors, %u linedefs, %u entities\n", plan, lvl.n_sectors, lvl.n_linedefs, lvl.n_entities);
+
+	double t0 = now();
+	for (int i = 0; i < n_ticks; i++) {
+		wander(&lvl);
+	}
+	double elapsed = now() - t0;
+
+	double entity_ticks = (double)n_ticks * (double)lvl.n_entities;
+	printf("%d ticks in %.3fs: %.1f ticks/s (%.2fx realtime), %.1f ns/entity-tick\n",
+		n_ticks,
+		elapsed,
+		(double)n_ticks / elapsed,
+		(double)n_ticks / elapsed / (double)TICK_HZ,
+		entity_ticks > 0 ? elapsed * 1e9 / entity_ticks : 0.0);
+
+	if (print_checksum) {
+		printf("checksum: %016llx\n", (unsigned long long)checksum(&lvl));
+	}
+
+	lvl_free(&lvl);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#include <string.h>
+
+#include "stats.h"
+
+struct stats stats = {
+	.frame = {.gpu_ms = -1},
+	.last = {.gpu_ms = -1},
+};
+
+__thread struct stats_frame* stats_counters = &stats.frame;
+
+void stats_reset_frame(struct stats_frame* f)
+{
+	memset(f, 0, sizeof(*f));
+	f->gpu_ms = -1;
+}
+
+void stats_merge(struct stats_frame* f)
+{
+	struct stats_frame* d = &stats.frame;
+	d->render_ms = f->render_ms;
+	if (f->gpu_ms >= 0) d->gpu_ms = f->gpu_ms;
+	d->draw_calls += f->draw_calls;
+	d->vertices += f->vertices;
+	d->indices += f->indices;
+	d->texture_binds += f->texture_binds;
+	d->tessellations += f->tessellations;
+	d->sectors_visited += f->sectors_visited;
+	d->entities_simulated += f->entities_simulated;
+	d->frame_bytes += f->frame_bytes;
+}
+
+void stats_end_frame(float frame_ms)
+{
+	stats.frame.frame_ms = frame_ms;
+	stats.frame_ms[stats.n_frames % STATS_HISTORY] = frame_ms;
+	stats.n_frames++;
+
+	memcpy(&stats.last, &stats.frame, sizeof(stats.last));
+	stats_reset_frame(&stats.frame);
+}
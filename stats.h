@@ -0,0 +1,48 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/* per frame counters. the renderer and the lvl code bump the counters of
+ * the frame in progress; stats_end_frame() (main thread) makes it the last
+ * complete frame, which is what gets shown. other threads count into a
+ * stats_frame of their own, by pointing stats_counters at it, and the main
+ * thread stats_merge()s it */
+
+#define STATS_HISTORY (128) // frame times kept for the graph
+
+struct stats_frame {
+	float frame_ms;
+	float sim_ms;
+	float render_ms;
+	float gpu_ms; // < 0 while unknown
+
+	uint32_t draw_calls;
+	uint32_t vertices; // streamed to GL
+	uint32_t indices; // streamed to GL
+	uint32_t texture_binds;
+	uint32_t tessellations;
+	uint32_t sectors_visited; // by entity clipping and traces
+	uint32_t entities_simulated;
+	uint32_t frame_bytes; // of frame_alloc()s
+};
+
+struct stats {
+	struct stats_frame frame; // in progress
+	struct stats_frame last;
+
+	uint32_t n_frames;
+	float frame_ms[STATS_HISTORY]; // by n_frames % STATS_HISTORY
+};
+
+extern struct stats stats;
+extern __thread struct stats_frame* stats_counters; // &stats.frame by default
+
+#define STATS_ADD(counter, n) (stats_counters->counter += (n))
+
+void stats_reset_frame(struct stats_frame* f);
+// adds f's counters into the frame in progress, and takes its render/gpu times
+void stats_merge(struct stats_frame* f);
+void stats_end_frame(float frame_ms);
+
+#endif/*STATS_H*/
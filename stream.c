@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "stream.h"
+#include "a.h"
+#include "stats.h"
+
+void stream_init(struct stream* s, GLenum target, size_t elem_sz, uint32_t initial)
+{
+	memset(s, 0, sizeof(*s));
+	s->target = target;
+	s->elem_sz = elem_sz;
+	stream_reserve(s, initial);
+
+	if (target == 0) return;
+	glGenBuffers(1, &s->buffer); CHKGL;
+	glBindBuffer(target, s->buffer); CHKGL;
+	glBufferData(target, s->reserved * elem_sz, NULL, GL_STREAM_DRAW); CHKGL;
+	s->gl_reserved = s->reserved;
+}
+
+void stream_free(struct stream* s)
+{
+	if (s->buffer) {
+		glDeleteBuffers(1, &s->buffer); CHKGL;
+	}
+	free(s->data);
+	memset(s, 0, sizeof(*s));
+}
+
+void stream_reserve(struct stream* s, uint32_t n)
+{
+	if (n <= s->reserved) return;
+	uint32_t r = s->reserved ? s->reserved : 256;
+	while (r < n) r *= 2;
+	s->data = realloc(s->data, r * s->elem_sz);
+	AN(s->data);
+	s->reserved = r;
+}
+
+void stream_reset(struct stream* s)
+{
+	if (s->n > s->peak) s->peak = s->n;
+	s->n = 0;
+}
+
+void stream_upload(struct stream* s)
+{
+	ASSERT(s->target != 0);
+	if (s->n > s->peak) s->peak = s->n;
+	if (s->target == GL_ELEMENT_ARRAY_BUFFER) {
+		STATS_ADD(indices, s->n);
+	} else {
+		STATS_ADD(vertices, s->n);
+	}
+	glBindBuffer(s->target, s->buffer); CHKGL;
+	if (s->n > s->gl_reserved) {
+		// (reallocates the storage, so it also orphans the old one)
+		glBufferData(s->target, s->reserved * s->elem_sz, s->data, GL_STREAM_DRAW); CHKGL;
+		s->gl_reserved = s->reserved;
+	} else {
+		glBufferSubData(s->target, 0, s->n * s->elem_sz, s->data); CHKGL;
+	}
+}
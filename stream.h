@@ -0,0 +1,41 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <GL/glew.h>
+
+/* client side array + GL_STREAM_DRAW buffer, refilled every frame. both
+ * sides grow geometrically when a frame needs more room (and then stay
+ * that size), so there's no hard cap on how much a frame can draw, and
+ * small levels don't pay for big ones. a target of 0 makes a client side
+ * only stream */
+
+struct stream {
+	GLenum target;
+	GLuint buffer;
+	size_t elem_sz;
+
+	uint32_t n, reserved;
+	uint32_t gl_reserved; // elements the GL buffer has room for
+	uint32_t peak; // high-water mark of n at upload/reset
+	void* data;
+};
+
+void stream_init(struct stream* s, GLenum target, size_t elem_sz, uint32_t initial);
+void stream_free(struct stream* s);
+void stream_reserve(struct stream* s, uint32_t n);
+
+static inline void* stream_push(struct stream* s, uint32_t n)
+{
+	if (s->n + n > s->reserved) stream_reserve(s, s->n + n);
+	void* p = (uint8_t*)s->data + (size_t)s->n * s->elem_sz;
+	s->n += n;
+	return p;
+}
+
+void stream_reset(struct stream* s);
+
+// binds the buffer to its target and uploads the n elements
+void stream_upload(struct stream* s);
+
+#endif/*STREAM_H*/
@@ -0,0 +1,31 @@
+#include <SDL.h>
+
+#include "tick.h"
+
+void tick_init(struct tick* tick)
+{
+	tick->frequency = SDL_GetPerformanceFrequency();
+	tick->step = tick->frequency / TICK_HZ;
+	tick->last = SDL_GetPerformanceCounter();
+	tick->accumulator = 0;
+	tick->n = 0;
+	tick->alpha = 0;
+}
+
+int tick_frame(struct tick* tick)
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+	tick->accumulator += now - tick->last;
+	tick->last = now;
+
+	int steps = tick->accumulator / tick->step;
+	if (steps > TICK_MAX_STEPS) {
+		steps = TICK_MAX_STEPS;
+		tick->accumulator = steps * tick->step;
+	}
+	tick->accumulator -= steps * tick->step;
+	tick->n += steps;
+
+	tick->alpha = (float)tick->accumulator / (float)tick->step;
+	return steps;
+}
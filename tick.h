@@ -0,0 +1,34 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <stdint.h>
+
+/* fixed timestep. the simulation always advances in steps of TICK_DT, no
+ * matter how long frames take; tick_frame() says how many steps are due
+ * and how far into the next one the frame is (alpha), so what's drawn can
+ * be interpolated between the last two steps */
+
+#define TICK_HZ (120)
+#define TICK_DT (1.0f / (float)TICK_HZ)
+
+/* cap on steps per frame. when a frame is slower than this many ticks the
+ * backlog is dropped and the game slows down, rather than spending ever
+ * longer frames catching up */
+#define TICK_MAX_STEPS (8)
+
+struct tick {
+	uint64_t frequency; // performance counter ticks per second
+	uint64_t step; // performance counter ticks per TICK_DT
+	uint64_t last;
+	uint64_t accumulator;
+
+	uint64_t n; // steps run so far
+	float alpha;
+};
+
+void tick_init(struct tick* tick);
+
+// returns the number of steps to run before drawing this frame
+int tick_frame(struct tick* tick);
+
+#endif/*TICK_H*/
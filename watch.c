@@ -0,0 +1,201 @@
+#include <sys/inotify.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "watch.h"
+#include "names.h"
+#include "prof.h"
+#include "a.h"
+
+// (inotify isn't recursive, so subdirectories are listed explicitly)
+static const char* watch_dirs[] = { "gfx", "dgfx", "workbench", "workbench/nomnom", NULL };
+
+static int find_name(const char** names, const char* name)
+{
+	int i = 0;
+	for (const char** n = names; *n; n++) {
+		if (strcmp(name, *n) == 0) return i;
+		i++;
+	}
+	return -1;
+}
+
+static int has_suffix(const char* s, const char* suffix)
+{
+	size_t n = strlen(s);
+	size_t m = strlen(suffix);
+	return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static struct watch_asset* decode(const char* dir, const char* file)
+{
+	static char path[1024];
+	static char base[256];
+
+	if (strlen(dir) + strlen(file) + 2 > sizeof(path)) return NULL;
+	sprintf(path, "%s/%s", dir, file);
+
+	struct watch_asset asset;
+	memset(&asset, 0, sizeof(asset));
+	asset.index = -1;
+	int e = 0;
+
+	if (has_suffix(file, ".png")) {
+		size_t n = strlen(file) - 4;
+		if (n >= sizeof(base)) return NULL;
+		memcpy(base, file, n);
+		base[n] = 0;
+
+		if (strcmp(dir, "gfx") == 0) {
+			if ((asset.index = find_name(names_flats, base)) >= 0) {
+				asset.kind = WATCH_FLAT;
+			} else if ((asset.index = find_name(names_walls, base)) >= 0) {
+				asset.kind = WATCH_WALL;
+			} else if ((asset.index = find_name(names_sprites, base)) >= 0) {
+				asset.kind = WATCH_SPRITE;
+			} else if (strcmp(base, "font6") == 0) {
+				asset.kind = WATCH_FONT;
+			}
+		} else if (strcmp(dir, "dgfx") == 0 && strcmp(base, "palette_table") == 0) {
+			asset.kind = WATCH_PALETTE_TABLE;
+		} else if (strcmp(dir, "workbench/nomnom") == 0 && strcmp(base, "x") == 0) {
+			asset.kind = WATCH_NOMNOM_TEXTURE;
+		}
+
+		if (asset.kind == WATCH_PALETTE_TABLE) {
+			e = mud_load_png_rgb(path, &asset.data, &asset.width, &asset.height);
+		} else if (asset.kind) {
+			e = mud_load_png_paletted(path, &asset.data, &asset.width, &asset.height);
+		}
+	} else if (strcmp(dir, "workbench/nomnom") == 0 && strcmp(file, "nomnom-v2.msh") == 0) {
+		asset.kind = WATCH_NOMNOM_MSH;
+		e = mud_load_msh(path, &asset.msh);
+	}
+
+	if (!asset.kind) return NULL;
+
+	// (the old asset stays; it'll be picked up when the file is written again)
+	if (e == -1) {
+		fprintf(stderr, "watch: not reloading %s\n", path);
+		return NULL;
+	}
+
+	printf("watch: reloaded %s\n", path);
+
+	struct watch_asset* a = malloc(sizeof(*a));
+	AN(a);
+	memcpy(a, &asset, sizeof(*a));
+	return a;
+}
+
+static void push(struct watch* watch, struct watch_asset* asset)
+{
+	SAZ(SDL_LockMutex(watch->mutex));
+	if (watch->tail) {
+		watch->tail->next = asset;
+	} else {
+		watch->head = asset;
+	}
+	watch->tail = asset;
+	SAZ(SDL_UnlockMutex(watch->mutex));
+}
+
+static const char* wd_dir(struct watch* watch, int wd)
+{
+	for (int i = 0; watch_dirs[i]; i++) {
+		if (watch->wd[i] == wd) return watch_dirs[i];
+	}
+	return NULL;
+}
+
+static int watch_thread(void* usr)
+{
+	struct watch* watch = usr;
+
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	// (runs until the process exits, so the ring is never given back)
+	PROF_THREAD_BEGIN("watch");
+
+	while (1) {
+		ssize_t n = read(watch->fd, buf, sizeof(buf));
+		if (n == -1) {
+			if (errno == EINTR) continue;
+			arghf("watch: read: %s", strerror(errno));
+		}
+
+		SAZ(SDL_LockMutex(watch->decoding));
+		for (char* p = buf; p < buf + n; ) {
+			struct inotify_event* ev = (struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->len == 0) continue;
+			const char* dir = wd_dir(watch, ev->wd);
+			if (dir == NULL) continue;
+
+			struct watch_asset* asset = decode(dir, ev->name);
+			if (asset) push(watch, asset);
+		}
+		SAZ(SDL_UnlockMutex(watch->decoding));
+	}
+
+	return 0;
+}
+
+void watch_init(struct watch* watch)
+{
+	memset(watch, 0, sizeof(*watch));
+
+	watch->fd = inotify_init();
+	if (watch->fd == -1) arghf("inotify_init: %s", strerror(errno));
+
+	for (int i = 0; watch_dirs[i]; i++) {
+		ASSERT(i < WATCH_MAX_DIRS);
+		// IN_CLOSE_WRITE rather than IN_MODIFY so we don't decode half-written files
+		watch->wd[i] = inotify_add_watch(watch->fd, watch_dirs[i], IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watch->wd[i] == -1) {
+			fprintf(stderr, "watch: not watching %s: %s\n", watch_dirs[i], strerror(errno));
+		}
+	}
+
+	watch->mutex = SDL_CreateMutex();
+	SAN(watch->mutex);
+	watch->decoding = SDL_CreateMutex();
+	SAN(watch->decoding);
+
+	watch->thread = SDL_CreateThread(watch_thread, "watch", watch);
+	SAN(watch->thread);
+}
+
+struct watch_asset* watch_poll(struct watch* watch)
+{
+	SAZ(SDL_LockMutex(watch->mutex));
+	struct watch_asset* asset = watch->head;
+	if (asset) {
+		watch->head = asset->next;
+		if (watch->head == NULL) watch->tail = NULL;
+		asset->next = NULL;
+	}
+	SAZ(SDL_UnlockMutex(watch->mutex));
+	return asset;
+}
+
+void watch_pause(struct watch* watch)
+{
+	SAZ(SDL_LockMutex(watch->decoding));
+}
+
+void watch_resume(struct watch* watch)
+{
+	SAZ(SDL_UnlockMutex(watch->decoding));
+}
+
+void watch_free_asset(struct watch_asset* asset)
+{
+	// (mesh data is handed over to the renderer, see render_reload())
+	if (asset->data) free(asset->data);
+	free(asset);
+}
@@ -0,0 +1,59 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+#include <SDL.h>
+
+#include "mud.h"
+
+/* asset hot reloading. watches gfx/, dgfx/ and workbench/ with inotify and
+ * re-decodes changed files on a background thread; the decoded assets are
+ * handed to the GL thread through watch_poll() */
+
+enum watch_kind {
+	WATCH_FLAT = 1,
+	WATCH_WALL,
+	WATCH_SPRITE,
+	WATCH_FONT,
+	WATCH_PALETTE_TABLE,
+	WATCH_NOMNOM_TEXTURE,
+	WATCH_NOMNOM_MSH
+};
+
+struct watch_asset {
+	enum watch_kind kind;
+	int index; // slot in names_flats/names_walls/names_sprites
+
+	uint8_t* data;
+	int width;
+	int height;
+
+	struct msh msh;
+
+	struct watch_asset* next;
+};
+
+#define WATCH_MAX_DIRS (8)
+
+struct watch {
+	int fd;
+	int wd[WATCH_MAX_DIRS];
+	SDL_Thread* thread;
+	SDL_mutex* mutex;
+	SDL_mutex* decoding; // held by the watch thread while it decodes
+	struct watch_asset* head;
+	struct watch_asset* tail;
+};
+
+void watch_init(struct watch* watch);
+
+// returns the next decoded asset or NULL; free with watch_free_asset()
+struct watch_asset* watch_poll(struct watch* watch);
+void watch_free_asset(struct watch_asset* asset);
+
+/* keeps the watch thread from decoding (so from recording zones) until
+ * watch_resume(); e.g. around prof_dump(). waits for a decode in progress */
+void watch_pause(struct watch* watch);
+void watch_resume(struct watch* watch);
+
+#endif/*WATCH_H*/
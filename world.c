@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "world.h"
+#include "llvl.h"
+#include "prof.h"
+#include "a.h"
+
+static void link_placements(struct world* world)
+{
+	struct plan* plan = &world->plan;
+	uint32_t n = plan->n_placements;
+
+	world->link0 = calloc(n + 1, sizeof(*world->link0));
+	AN(world->link0);
+	for (int i = 0; i < n; i++) {
+		int32_t parent = plan->placements[i].parent;
+		if (parent == -1) continue;
+		world->link0[i+1]++;
+		world->link0[parent+1]++;
+	}
+	for (int i = 0; i < n; i++) world->link0[i+1] += world->link0[i];
+
+	world->links = malloc(world->link0[n] * sizeof(*world->links) + 1);
+	AN(world->links);
+	uint32_t* fill = malloc(n * sizeof(*fill) + 1);
+	AN(fill);
+	memcpy(fill, world->link0, n * sizeof(*fill));
+	for (int i = 0; i < n; i++) {
+		int32_t parent = plan->placements[i].parent;
+		if (parent == -1) continue;
+		world->links[fill[i]++] = parent;
+		world->links[fill[parent]++] = i;
+	}
+	free(fill);
+}
+
+void world_init(struct world* world, const char* plan, uint32_t seed, int hops)
+{
+	memset(world, 0, sizeof(*world));
+	ASSERT(hops >= 0);
+	world->hops = hops;
+
+	llvl_layout(plan, seed, &world->plan);
+	uint32_t n = world->plan.n_placements;
+	if (n == 0) arghf("plan \"%s\" has no bricks", plan);
+
+	link_placements(world);
+
+	world->hop = malloc(n * sizeof(*world->hop));
+	AN(world->hop);
+	for (int i = 0; i < n; i++) world->hop[i] = -1;
+
+	world->center = -1;
+}
+
+void world_free(struct world* world)
+{
+	plan_free(&world->plan);
+	free(world->link0);
+	free(world->links);
+	free(world->hop);
+	free(world->live);
+	free(world->ranges);
+	memset(world, 0, sizeof(*world));
+}
+
+static int cmp_i32(const void* a, const void* b)
+{
+	int32_t x = *(const int32_t*)a;
+	int32_t y = *(const int32_t*)b;
+	return (x > y) - (x < y);
+}
+
+/* the placements within hops of center, breadth first (so world->hop only
+ * gets touched for those), then sorted, so parents are instantiated before
+ * their children */
+static uint32_t find_live(struct world* world, int32_t center, int32_t** live)
+{
+	uint32_t n = 0, reserved = 16;
+	int32_t* queue = malloc(reserved * sizeof(*queue));
+	AN(queue);
+	queue[n++] = center;
+	world->hop[center] = 0;
+	for (uint32_t head = 0; head < n; head++) {
+		int32_t i = queue[head];
+		if (world->hop[i] == world->hops) continue;
+		for (uint32_t j = world->link0[i]; j < world->link0[i+1]; j++) {
+			int32_t k = world->links[j];
+			if (world->hop[k] != -1) continue;
+			world->hop[k] = world->hop[i] + 1;
+			if (n == reserved) {
+				reserved *= 2;
+				queue = realloc(queue, reserved * sizeof(*queue));
+				AN(queue);
+			}
+			queue[n++] = k;
+		}
+	}
+	for (uint32_t i = 0; i < n; i++) world->hop[queue[i]] = -1;
+	qsort(queue, n, sizeof(*queue), cmp_i32);
+	*live = queue;
+	return n;
+}
+
+// index into live[] of a placement, or -1
+static int32_t find_slot(int32_t* live, uint32_t n_live, int32_t placement)
+{
+	int32_t* p = bsearch(&placement, live, n_live, sizeof(*live), cmp_i32);
+	return p == NULL ? -1 : p - live;
+}
+
+// index into ranges[] of the brick a live sector is in
+static int32_t sector_slot(struct plan_range* ranges, uint32_t n_live, int32_t sector)
+{
+	ASSERT(sector >= 0);
+	uint32_t lo = 0, hi = n_live;
+	while (hi - lo > 1) {
+		uint32_t mid = (lo + hi) / 2;
+		if (ranges[mid].sector0 <= sector) lo = mid; else hi = mid;
+	}
+	ASSERT(sector < ranges[lo].sector0 + ranges[lo].n_sectors);
+	return lo;
+}
+
+static int32_t remap_sector(int32_t sector, struct plan_range* from, struct plan_range* to)
+{
+	if (sector < from->sector0 || sector >= from->sector0 + from->n_sectors) return sector;
+	return sector - from->sector0 + to->sector0;
+}
+
+static void place_fresh(struct lvl* lvl, struct lvl_entity* e)
+{
+	if (e->type != ENTITY_DELETED) {
+		lvl_entity_update_sector(lvl, e);
+		if (e->sector != -1) {
+			e->z = lvl_get_sector(lvl, e->sector)->flat[0].z + lvl_entity_type(e)->height;
+		}
+	}
+	// (else it would lerp from where the brick has it)
+	lvl_entity_begin_tick(e);
+}
+
+/* a live level for the bricks around center. entities of bricks that were
+ * live in old (if not NULL) are carried over */
+static struct lvl* build(struct world* world, int32_t center, struct lvl* old)
+{
+	PROF_ZONE("world_build");
+
+	struct plan* plan = &world->plan;
+
+	int32_t* live;
+	uint32_t n_live = find_live(world, center, &live);
+	struct plan_range* ranges = malloc(n_live * sizeof(*ranges));
+	AN(ranges);
+
+	struct lvl* lvl = malloc(sizeof(*lvl));
+	AN(lvl);
+	lvl_init(lvl);
+	if (old) lvl->seed = old->seed;
+
+	for (uint32_t i = 0; i < n_live; i++) {
+		struct plan_placement* p = &plan->placements[live[i]];
+
+		// join the parent's portal, if the parent is live
+		int32_t join = -1;
+		int32_t parent_slot = p->parent == -1 ? -1 : find_slot(live, n_live, p->parent);
+		if (parent_slot != -1) {
+			struct plan_placement* pp = &plan->placements[p->parent];
+			int joined = pp->parent != -1 && find_slot(live, n_live, pp->parent) != -1;
+			join = ranges[parent_slot].linedef0 + p->parent_portal - (joined && p->parent_portal > pp->brick_portal);
+		}
+		plan_instantiate(plan, live[i], lvl, join, &ranges[i]);
+
+		int32_t old_slot = old ? find_slot(world->live, world->n_live, live[i]) : -1;
+		if (old_slot == -1) continue;
+		struct plan_range* from = &world->ranges[old_slot];
+		ASSERT(from->n_entities == ranges[i].n_entities);
+		for (uint32_t j = 0; j < ranges[i].n_entities; j++) {
+			struct lvl_entity* e = lvl_get_entity(lvl, ranges[i].entity0 + j);
+			memcpy(e, lvl_get_entity(old, from->entity0 + j), sizeof(*e));
+		}
+	}
+
+	lvl_build_contours(lvl);
+
+	/* fresh entities have the brick's sector and z; they're put on their
+	 * floor here, since slow thinkers won't move for a while */
+	for (uint32_t i = 0; i < n_live; i++) {
+		if (old && find_slot(world->live, world->n_live, live[i]) != -1) continue;
+		for (uint32_t j = 0; j < ranges[i].n_entities; j++) {
+			place_fresh(lvl, lvl_get_entity(lvl, ranges[i].entity0 + j));
+		}
+	}
+
+	/* carried over entities may have wandered into other bricks; their
+	 * sectors are remapped once all the new ranges are known. ones that are
+	 * in a brick that's dropped go (until their own brick respawns) */
+	if (old) {
+		for (uint32_t i = 0; i < n_live; i++) {
+			int32_t old_slot = find_slot(world->live, world->n_live, live[i]);
+			if (old_slot == -1) continue;
+			for (uint32_t j = 0; j < ranges[i].n_entities; j++) {
+				struct lvl_entity* e = lvl_get_entity(lvl, ranges[i].entity0 + j);
+				if (e->sector < 0 || e->sector >= old->n_sectors) continue;
+				int32_t from = sector_slot(world->ranges, world->n_live, e->sector);
+				int32_t to = find_slot(live, n_live, world->live[from]);
+				if (to == -1) {
+					e->type = ENTITY_DELETED;
+					e->sector = -1;
+				} else {
+					e->sector = remap_sector(e->sector, &world->ranges[from], &ranges[to]);
+				}
+			}
+		}
+	}
+
+	free(world->live);
+	free(world->ranges);
+	world->center = center;
+	world->n_live = n_live;
+	world->live = live;
+	world->ranges = ranges;
+	return lvl;
+}
+
+struct lvl* world_begin(struct world* world)
+{
+	return build(world, 0, NULL);
+}
+
+struct lvl* world_update(struct world* world, struct lvl* lvl, struct lvl_entity* player)
+{
+	if (player->sector < 0 || player->sector >= lvl->n_sectors) return NULL;
+	int32_t slot = sector_slot(world->ranges, world->n_live, player->sector);
+	int32_t center = world->live[slot];
+	if (center == world->center) return NULL;
+
+	struct plan_range from = world->ranges[slot];
+	struct lvl* next = build(world, center, lvl);
+	int32_t to = find_slot(world->live, world->n_live, center);
+	player->sector = remap_sector(player->sector, &from, &world->ranges[to]);
+	return next;
+}
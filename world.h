@@ -0,0 +1,46 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdint.h>
+
+#include "lvl.h"
+#include "plan.h"
+
+/* streaming levels. a plan is only laid out (see llvl_layout()), and just
+ * the bricks within some number of portal hops of the player's brick are
+ * instantiated into a live level; the memory and per frame work that costs
+ * depends on the hop count, not the length of the plan.
+ *
+ * when the player moves into another brick, a new live level is built for
+ * the bricks around it. it's in the same coordinates, entities of bricks
+ * that stay keep their state, and bricks that are dropped come back fresh.
+ * portals to bricks that aren't live are walls */
+
+struct world {
+	struct plan plan;
+	int hops;
+
+	// placements next to each placement (parent and children)
+	uint32_t* link0; // n_placements+1 prefix sums
+	int32_t* links;
+
+	int32_t* hop; // by placement, while finding the live ones; -1 if too far
+
+	int32_t center; // placement the player is in
+	uint32_t n_live;
+	int32_t* live; // live placements, ascending
+	struct plan_range* ranges; // of live[i] in the live level
+};
+
+void world_init(struct world* world, const char* plan, uint32_t seed, int hops);
+void world_free(struct world* world);
+
+// the live level around the first brick
+struct lvl* world_begin(struct world* world);
+
+/* call after the player moved. if the player is in another brick now,
+ * returns a new live level (and points player->sector into it); the old
+ * one can be freed once nothing uses it. otherwise returns NULL */
+struct lvl* world_update(struct world* world, struct lvl* lvl, struct lvl_entity* player);
+
+#endif/*WORLD_H*/